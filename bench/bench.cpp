@@ -0,0 +1,321 @@
+#include "corpus.h"
+
+#include "buffer-source.h"
+#include "exception.h"
+#include "tokenizer.h"
+#include "toml.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace ccm::toml;
+using namespace ccm::toml::bench;
+using namespace std;
+
+// Every allocation made by the process is counted, so the harness can report
+// how many the tokenizer makes per megabyte of input. The parallel rows
+// allocate on several threads at once, so the count is atomic; nothing is
+// ordered by it.
+static atomic<size_t> allocations{ 0 };
+
+void *operator new(size_t size) {
+   allocations.fetch_add(1, memory_order_relaxed);
+   if (void *p = malloc(size ? size : 1)) {
+      return p;
+   }
+   throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+   free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+   free(p);
+}
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+// A streambuf reading from memory without copying it, so that streaming runs
+// measure the tokenizer rather than istringstream's copy of the input.
+class ViewBuf : public streambuf {
+public:
+   ViewBuf(const string &s) {
+      char *p = const_cast<char *>(s.data());
+      setg(p, p, p + s.size());
+   }
+};
+
+struct Stats {
+   size_t bytes = 0;
+   size_t tokens = 0;
+   size_t allocations = 0;
+   double seconds = 0;
+   vector<double> latencies;
+};
+
+template<int N>
+size_t tokenizeStream(const string &doc) {
+   ViewBuf buf(doc);
+   istream in(&buf);
+   Tokenizer<N> tokenizer(in);
+   size_t tokens = 0;
+   while (tokenizer.more()) {
+      tokenizer.next();
+      ++tokens;
+   }
+   return tokens;
+}
+
+template<int N>
+size_t tokenizeBuffer(const string &doc) {
+   Tokenizer<N, BufferSource> tokenizer{string_view(doc)};
+   size_t tokens = 0;
+   while (tokenizer.more()) {
+      tokenizer.next();
+      ++tokens;
+   }
+   return tokens;
+}
+
+// Parses a whole Document. The parser doesn't say how many tokens it read, so
+// none are counted.
+size_t parseBuffer(const string &doc) {
+   parse(doc);
+   return 0;
+}
+
+// Parses a whole Document on four threads, in parts of at least 256 KiB.
+size_t parseParallel(const string &doc) {
+   ParseOptions options;
+   options.threads = 4;
+   options.minChunk = 256 * 1024;
+   parse(doc, options);
+   return 0;
+}
+
+// Walks a document's parser events without building anything.
+struct NullHandler {
+   size_t values = 0;
+
+   void onTableHeader(const DottedKey &) { }
+   void onArrayTableHeader(const DottedKey &) { }
+   void onKey(const DottedKey &) { }
+   template<typename T>
+   void onValue(const T &)
+      { ++values; }
+   void onArrayBegin() { }
+   void onArrayEnd() { }
+   void onInlineTableBegin() { }
+   void onInlineTableEnd() { }
+};
+
+size_t parseEventsBuffer(const string &doc) {
+   NullHandler handler;
+   parseEvents(doc, handler);
+   return 0;
+}
+
+// Writes each document back out into a reused string. Documents are parsed
+// the first time they are seen, so the corpus is written once before it is
+// measured.
+size_t writeBuffer(const string &doc) {
+   static map<const string *, Document> parsed;
+   static string out;
+   auto it = parsed.find(&doc);
+   if (it == parsed.end()) {
+      it = parsed.emplace(&doc, parse(doc)).first;
+   }
+   out.clear();
+   Writer(out).document(it->second);
+   return 0;
+}
+
+// Edits each document kept in an IncrementalDocument, alternately adding
+// and removing a comment line at the line start nearest its middle, which is
+// valid wherever it lands. As with writeBuffer(), documents are loaded the
+// first time they are seen.
+size_t editBuffer(const string &doc) {
+   struct Edited {
+      unique_ptr<IncrementalDocument> doc;
+      size_t line;
+      bool added = false;
+   };
+   static map<const string *, Edited> loaded;
+   static const string comment = "# edited\n";
+   auto it = loaded.find(&doc);
+   if (it == loaded.end()) {
+      size_t newline = doc.find('\n', doc.size() / 2);
+      size_t line = newline == string::npos ? doc.size() : newline + 1;
+      auto incremental = make_unique<IncrementalDocument>(doc);
+      it = loaded.emplace(&doc, Edited{ move(incremental), line }).first;
+   }
+   Edited &edited = it->second;
+   if (edited.added) {
+      edited.doc->edit(edited.line, comment.size(), "");
+   }
+   else {
+      edited.doc->edit(edited.line, 0, comment);
+   }
+   edited.added = !edited.added;
+   return 0;
+}
+
+// Tokenizes every document in the corpus, timing each one, until at least
+// minSeconds have passed.
+Stats measure(const Corpus &corpus, size_t (*tokenize)(const string &),
+              double minSeconds)
+{
+   Stats stats;
+   do {
+      for (const string &doc : corpus.documents) {
+         size_t allocationsBefore = allocations.load(memory_order_relaxed);
+         Clock::time_point start = Clock::now();
+         stats.tokens += tokenize(doc);
+         Clock::time_point end = Clock::now();
+         stats.allocations += allocations.load(memory_order_relaxed)
+                              - allocationsBefore;
+
+         double seconds = chrono::duration<double>(end - start).count();
+         stats.seconds += seconds;
+         stats.latencies.push_back(seconds);
+         stats.bytes += doc.size();
+      }
+   } while (stats.seconds < minSeconds);
+   return stats;
+}
+
+double percentile(vector<double> &values, double p) {
+   size_t i = static_cast<size_t>(p * (values.size() - 1));
+   nth_element(values.begin(), values.begin() + i, values.end());
+   return values[i];
+}
+
+void report(const Corpus &corpus, const string &config, Stats &stats) {
+   double megabytes = stats.bytes / 1e6;
+   cout << left << setw(20) << corpus.name << setw(12) << config << right
+        << fixed << setprecision(1)
+        << setw(10) << megabytes / stats.seconds
+        << setw(12) << stats.tokens / stats.seconds / 1e6
+        << setw(12) << stats.allocations / megabytes
+        << setprecision(2)
+        << setw(12) << percentile(stats.latencies, 0.50) * 1e6
+        << setw(12) << percentile(stats.latencies, 0.99) * 1e6
+        << '\n';
+}
+
+void writeCorpora(const vector<Corpus> &corpora, const string &dir) {
+   namespace fs = filesystem;
+   for (const Corpus &corpus : corpora) {
+      if (corpus.documents.size() == 1) {
+         fs::create_directories(dir);
+         ofstream(fs::path(dir) / (corpus.name + ".toml"))
+            << corpus.documents[0];
+         continue;
+      }
+      fs::path sub = fs::path(dir) / corpus.name;
+      fs::create_directories(sub);
+      for (size_t i = 0; i < corpus.documents.size(); ++i) {
+         ofstream(sub / (to_string(i) + ".toml")) << corpus.documents[i];
+      }
+   }
+}
+
+void usage(const char *argv0) {
+   cerr << "Usage: " << argv0 << " [--size MB] [--time SECONDS]"
+        << " [--write DIR]\n"
+        << "  --size   size of each generated corpus (default 4)\n"
+        << "  --time   minimum time to spend per measurement (default 0.25)\n"
+        << "  --write  write the corpora to DIR instead of benchmarking\n";
+}
+
+}
+
+int main(int argc, char **argv) {
+   double sizeMB = 4;
+   double minSeconds = 0.25;
+   string writeDir;
+
+   for (int i = 1; i < argc; ++i) {
+      string arg = argv[i];
+      if (i + 1 < argc && arg == "--size") {
+         sizeMB = stod(argv[++i]);
+      }
+      else if (i + 1 < argc && arg == "--time") {
+         minSeconds = stod(argv[++i]);
+      }
+      else if (i + 1 < argc && arg == "--write") {
+         writeDir = argv[++i];
+      }
+      else {
+         usage(argv[0]);
+         return 2;
+      }
+   }
+
+   vector<Corpus> corpora = standardCorpora(
+      static_cast<size_t>(sizeMB * 1024 * 1024));
+
+   if (!writeDir.empty()) {
+      writeCorpora(corpora, writeDir);
+      return 0;
+   }
+
+   struct Config {
+      const char *name;
+      size_t (*tokenize)(const string &);
+   };
+   const Config configs[] = {
+      { "stream<1>", tokenizeStream<1> },
+      { "stream<4>", tokenizeStream<4> },
+      { "buffer<1>", tokenizeBuffer<1> },
+      { "buffer<4>", tokenizeBuffer<4> },
+      { "parse", parseBuffer },
+      { "parse/4", parseParallel },
+      { "events", parseEventsBuffer },
+      { "write", writeBuffer },
+      { "edit", editBuffer },
+   };
+
+   cout << left << setw(20) << "corpus" << setw(12) << "tokenizer" << right
+        << setw(10) << "MB/s" << setw(12) << "Mtokens/s"
+        << setw(12) << "allocs/MB" << setw(12) << "p50 us"
+        << setw(12) << "p99 us" << '\n';
+
+   try {
+      for (const Corpus &corpus : corpora) {
+         for (const Config &config : configs) {
+            if (config.tokenize == writeBuffer
+                || config.tokenize == editBuffer)
+            {
+               for (const string &doc : corpus.documents) {
+                  config.tokenize(doc);
+               }
+            }
+            Stats stats = measure(corpus, config.tokenize, minSeconds);
+            report(corpus, config.name, stats);
+         }
+      }
+   }
+   catch (const SyntaxError &ex) {
+      cerr << "Syntax error at Line " << ex.line << " Character " << ex.col
+           << ": " << ex.what() << '\n';
+      return 1;
+   }
+
+   return 0;
+}
\ No newline at end of file
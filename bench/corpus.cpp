@@ -0,0 +1,218 @@
+#include "corpus.h"
+
+#include <array>
+#include <cstdint>
+#include <random>
+
+using namespace std;
+
+namespace ccm::toml::bench {
+
+namespace {
+
+constexpr uint64_t seed = 0x746f6d6c;
+
+const array<const char *, 16> words = {
+   "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+   "india", "juliett", "kilo", "lima", "mike", "november", "oscar", "papa"
+};
+
+class Generator {
+public:
+   Generator() : rng(seed) { }
+
+   uint64_t below(uint64_t n) { return rng() % n; }
+   const char *word() { return words[below(words.size())]; }
+
+   string integer() {
+      switch (below(4)) {
+      case 0:
+         return to_string(below(10));
+      case 1:
+         return "-" + to_string(below(100000));
+      case 2:
+         return to_string(rng() >> 1);
+      default:
+         return "1_000_" + to_string(100 + below(900));
+      }
+   }
+
+   string floating() {
+      string s = to_string(below(100000)) + "." + to_string(below(1000000));
+      if (below(3) == 0) {
+         s += "e" + to_string(static_cast<int>(below(40)) - 20);
+      }
+      return s;
+   }
+
+   string date() {
+      string s = "1979-05-27T07:32:00";
+      s[3] = static_cast<char>('0' + below(10));
+      s[9] = static_cast<char>('1' + below(9));
+      if (below(2)) {
+         s += "." + to_string(100000 + below(900000));
+      }
+      s += below(2) ? "Z" : "-07:00";
+      return s;
+   }
+
+private:
+   mt19937_64 rng;
+};
+
+}
+
+size_t Corpus::bytes() const {
+   size_t total = 0;
+   for (const string &doc : documents) {
+      total += doc.size();
+   }
+   return total;
+}
+
+// Long arrays of integers and floats, 64 to a line.
+Corpus numericArrays(size_t size) {
+   Generator gen;
+   string doc;
+   for (int i = 0; doc.size() < size; ++i) {
+      doc += "numbers_" + to_string(i) + " = [ ";
+      bool floats = i % 2;
+      for (int j = 0; j < 64; ++j) {
+         doc += floats ? gen.floating() : gen.integer();
+         doc += j < 63 ? ", " : " ]\n";
+      }
+   }
+   return { "numeric-arrays", { doc } };
+}
+
+// One key holding a single array of numbers and strings, 16 to a line.
+Corpus largeArray(size_t size) {
+   Generator gen;
+   string doc = "values = [\n";
+   for (int i = 0; doc.size() < size; ++i) {
+      switch (i % 4) {
+      case 0:
+         doc += gen.integer();
+         break;
+      case 1:
+         doc += gen.floating();
+         break;
+      default:
+         doc += "\"" + string(gen.word()) + "\"";
+         break;
+      }
+      doc += i % 16 == 15 ? ",\n" : ", ";
+   }
+   doc += "]\n";
+   return { "large-array", { doc } };
+}
+
+// Basic and literal multiline strings of up to a couple of hundred lines.
+Corpus multilineStrings(size_t size) {
+   Generator gen;
+   string doc;
+   for (int i = 0; doc.size() < size; ++i) {
+      bool literal = i % 2;
+      const char *quotes = literal ? "'''" : "\"\"\"";
+      doc += "text_" + to_string(i) + " = " + quotes + "\n";
+      uint64_t lines = 20 + gen.below(180);
+      for (uint64_t j = 0; j < lines; ++j) {
+         for (int k = 0; k < 8; ++k) {
+            doc += gen.word();
+            if (!literal && gen.below(16) == 0) {
+               doc += "\\t\\\"";
+            }
+            doc += ' ';
+         }
+         doc += '\n';
+      }
+      doc += quotes;
+      doc += '\n';
+   }
+   return { "multiline-strings", { doc } };
+}
+
+// Key/value pairs with deep dotted keys, some segments quoted.
+Corpus dottedKeys(size_t size) {
+   Generator gen;
+   string doc;
+   for (int i = 0; doc.size() < size; ++i) {
+      uint64_t depth = 8 + gen.below(9);
+      for (uint64_t j = 0; j < depth; ++j) {
+         if (gen.below(8) == 0) {
+            doc += '"';
+            doc += gen.word();
+            doc += ".quoted\"";
+         }
+         else {
+            doc += gen.word();
+         }
+         doc += '.';
+      }
+      doc += "key_" + to_string(i) + " = ";
+      switch (gen.below(3)) {
+      case 0:
+         doc += gen.integer();
+         break;
+      case 1:
+         doc += '"';
+         doc += gen.word();
+         doc += '"';
+         break;
+      default:
+         doc += gen.date();
+         break;
+      }
+      doc += '\n';
+   }
+   return { "dotted-keys", { doc } };
+}
+
+// Thousands of small [[array]] tables.
+Corpus arrayTables(size_t size) {
+   Generator gen;
+   string doc;
+   for (int i = 0; doc.size() < size; ++i) {
+      doc += "[[products]]\n";
+      doc += "name = \"" + string(gen.word()) + ' ' + gen.word() + "\"\n";
+      doc += "sku = " + to_string(gen.below(1000000000)) + '\n';
+      doc += "price = " + gen.floating() + '\n';
+      doc += "in_stock = " + string(gen.below(2) ? "true" : "false") + '\n';
+      doc += "added = " + gen.date() + '\n';
+      doc += "tags = { color = \"" + string(gen.word()) + "\", size = "
+             + to_string(gen.below(50)) + " }\n\n";
+   }
+   return { "array-tables", { doc } };
+}
+
+// Many small configuration-file sized documents.
+Corpus tinyDocuments(size_t count) {
+   Generator gen;
+   Corpus corpus{ "tiny-documents", {} };
+   corpus.documents.reserve(count);
+   for (size_t i = 0; i < count; ++i) {
+      string doc = "# document " + to_string(i) + '\n';
+      doc += "title = \"" + string(gen.word()) + "\"\n";
+      doc += "[owner]\nname = '" + string(gen.word()) + "'\n";
+      doc += "dob = " + gen.date() + '\n';
+      doc += "[database]\nports = [ " + gen.integer() + ", "
+             + gen.integer() + " ]\n";
+      doc += "enabled = true\nratio = " + gen.floating() + '\n';
+      corpus.documents.push_back(move(doc));
+   }
+   return corpus;
+}
+
+vector<Corpus> standardCorpora(size_t size) {
+   vector<Corpus> corpora;
+   corpora.push_back(numericArrays(size));
+   corpora.push_back(largeArray(size));
+   corpora.push_back(multilineStrings(size));
+   corpora.push_back(dottedKeys(size));
+   corpora.push_back(arrayTables(size));
+   // Roughly the same number of bytes as the others
+   corpora.push_back(tinyDocuments(size / 200));
+   return corpora;
+}
+
+}
\ No newline at end of file
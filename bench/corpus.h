@@ -0,0 +1,33 @@
+#ifndef CCM_TOML_BENCH_CORPUS_H
+#define CCM_TOML_BENCH_CORPUS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ccm::toml::bench {
+
+// A named set of TOML documents to benchmark against.
+struct Corpus {
+   std::string name;
+   std::vector<std::string> documents;
+
+   std::size_t bytes() const;
+};
+
+// Deterministic corpus generators. The same arguments always produce the same
+// documents, so numbers from different builds can be compared. Each of the
+// single-document generators produces roughly `size` bytes.
+Corpus numericArrays(std::size_t size);
+Corpus largeArray(std::size_t size);
+Corpus multilineStrings(std::size_t size);
+Corpus dottedKeys(std::size_t size);
+Corpus arrayTables(std::size_t size);
+Corpus tinyDocuments(std::size_t count);
+
+// All of the above, scaled so the large documents are `size` bytes each.
+std::vector<Corpus> standardCorpora(std::size_t size);
+
+}
+
+#endif
\ No newline at end of file
@@ -1,6 +1,145 @@
 #ifndef TOML_H
 #define TOML_H
 
-void print();
+#include "binding.h"
+#include "buffer-source.h"
+#include "decode.h"
+#include "document.h"
+#include "dotted-key.h"
+#include "exception.h"
+#include "incremental.h"
+#include "mapped-file.h"
+#include "parser.h"
+#include "query.h"
+#include "reader.h"
+#include "snapshot.h"
+#include "string-pool.h"
+#include "tokenizer.h"
+#include "writer.h"
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+struct ParseOptions {
+   ParseOptions(std::pmr::memory_resource *upstream
+                   = std::pmr::get_default_resource())
+      : upstream(upstream)
+      { }
+
+   // Where the document's arena gets its memory
+   std::pmr::memory_resource *upstream;
+
+   // If set, the document's keys and short strings are interned here and
+   // shared with other documents parsed with the same pool.
+   std::shared_ptr<StringPool> strings;
+
+   // parse(text) and parseFile() split documents of at least 2 * minChunk
+   // bytes into parts that begin at top-level [table] or [[array]] headers,
+   // parse up to `threads` of them at once (0 for one per core) and merge
+   // the results in order. If a part fails to parse, or defines something
+   // an earlier part did, the whole document is parsed again on one thread,
+   // so errors are reported exactly as without threads. Documents that can't
+   // be split that way have arrays of at least 2 * minChunk bytes split at
+   // commas between their elements instead, and those parsed likewise.
+   unsigned threads = 1;
+   std::size_t minChunk = 4 << 20;
+};
+
+// Parse a TOML document, throwing SyntaxError if it is malformed. Streams
+// are always parsed on one thread.
+Document parse(std::string_view text, const ParseOptions &options = {});
+Document parse(std::istream &in, const ParseOptions &options = {});
+
+// Parse the file at `path`, which is mapped into memory rather than read.
+// Throws Exception if the file can't be opened.
+Document parseFile(const std::string &path,
+                   const ParseOptions &options = {});
+
+// One of the files parsed by parseFiles(): its document, or what went wrong.
+struct LoadedFile {
+   std::string path;
+
+   // Empty if the file couldn't be read or parsed
+   std::optional<Document> document;
+
+   // Otherwise, why, and for syntax errors, where (or 0 and 0)
+   std::string error;
+   int line = 0;
+   int col = 0;
+};
+
+// Parse many files at once, on a pool of options.threads threads (0 for one
+// per core), each file on one thread. The largest files are started first,
+// and threads that run out of files take them from the others. Returns the
+// files in the order of `paths`. Files that can't be read or parsed get an
+// error rather than stopping the rest, so this never throws SyntaxError.
+// options.upstream must be safe to use from several threads at once.
+std::vector<LoadedFile> parseFiles(const std::vector<std::string> &paths,
+                                   const ParseOptions &options = {});
+
+// Parse the files whose paths match a glob(3) pattern, such as
+// "conf.d/*.toml", as parseFiles() does, in order by path. Throws Exception
+// if the pattern can't be searched for.
+std::vector<LoadedFile> parseGlob(const std::string &pattern,
+                                  const ParseOptions &options = {});
+
+// Parse a TOML document without building a Document, reporting its contents
+// to `handler` as they are read (see Parser for the events). This suits
+// callers that only want a few values, or that pass the contents on
+// elsewhere. Throws SyntaxError if the document is malformed, except that
+// keys and tables defined twice are left to the handler to detect.
+template<typename Handler>
+void parseEvents(std::string_view text, Handler &handler) {
+   Tokenizer<0, BufferSource> tokenizer(text);
+   Parser<Tokenizer<0, BufferSource>, Handler>(tokenizer, handler).parse();
+}
+
+template<typename Handler>
+void parseEvents(std::istream &in, Handler &handler) {
+   Tokenizer<0> tokenizer(in);
+   Parser<Tokenizer<0>, Handler>(tokenizer, handler).parse();
+}
+
+template<typename Handler>
+void parseFileEvents(const std::string &path, Handler &handler) {
+   Tokenizer<0, MappedFileSource> tokenizer(path);
+   Parser<Tokenizer<0, MappedFileSource>, Handler>(tokenizer, handler)
+      .parse();
+}
+
+// Parse a TOML document straight into `out`, a struct bound to its keys with
+// Fields<T>, without building a Document. Keys and tables it has no fields for
+// are skipped. Throws SyntaxError if the document is malformed or a value has
+// the wrong type for its field.
+template<typename T>
+void parseInto(std::string_view text, T &out) {
+   Tokenizer<0, BufferSource> tokenizer(text);
+   Reader reader(tokenizer);
+   bind(reader, out);
+}
+
+template<typename T>
+void parseInto(std::istream &in, T &out) {
+   Tokenizer<0> tokenizer(in);
+   Reader reader(tokenizer);
+   bind(reader, out);
+}
+
+template<typename T>
+void parseFileInto(const std::string &path, T &out) {
+   Tokenizer<0, MappedFileSource> tokenizer(path);
+   Reader reader(tokenizer);
+   bind(reader, out);
+}
+
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "array-split.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+// Moves through an array by its structural characters (see StructuralIndex),
+// keeping count of lines.
+class Scanner {
+public:
+   Scanner(string_view text, StructuralIndex &index,
+           ArraySplit::Position open)
+      : text(text),
+        index(index),
+        pos(open.offset + 1),
+        line(open.line),
+        lineStart(open.offset + 1 - open.col)
+      { }
+
+   // Moves to the next structural character, returning false at the end of
+   // the input.
+   bool next() {
+      pos = index.next(pos);
+      return pos < text.size();
+   }
+
+   char at() const
+      { return text[pos]; }
+
+   ArraySplit::Position position() const {
+      return ArraySplit::Position{ pos, line,
+                                   static_cast<int>(pos - lineStart) + 1 };
+   }
+
+   // Consumes the character at the current position.
+   void consume() {
+      if (text[pos] == '\n') {
+         ++line;
+         lineStart = pos + 1;
+      }
+      ++pos;
+   }
+
+   bool skipComment();
+   bool skipString();
+
+private:
+   string_view text;
+   StructuralIndex &index;
+   size_t pos;
+   int line;
+   size_t lineStart;
+};
+
+// Skips to the newline at the end of a comment.
+bool Scanner::skipComment() {
+   pos = text.find('\n', pos);
+   return pos != string_view::npos;
+}
+
+// Skips a string of any kind, returning false if it doesn't end.
+bool Scanner::skipString() {
+   char quote = text[pos];
+   string_view delimiter = quote == '"' ? "\"\"\"" : "'''";
+   bool multiline = text.substr(pos, 3) == delimiter;
+   pos += multiline ? 3 : 1;
+
+   while (next()) {
+      char c = at();
+      if (c == '\\' && quote == '"') {
+         consume();
+         if (pos == text.size()) {
+            return false;
+         }
+         consume();
+      }
+      else if (c == '\n' && !multiline) {
+         return false;
+      }
+      else if (c != quote) {
+         consume();
+      }
+      else if (!multiline) {
+         ++pos;
+         return true;
+      }
+      else if (text.substr(pos, 3) == delimiter) {
+         // Up to two more quotes belong to the string.
+         pos += 3;
+         for (int i = 0; i < 2 && pos < text.size() && text[pos] == quote;
+              ++i)
+         {
+            ++pos;
+         }
+         return true;
+      }
+      else {
+         consume();
+      }
+   }
+   return false;
+}
+
+}
+
+ArraySplitter::ArraySplitter(string_view text)
+   : text(text)
+{
+   index.reset(text);
+}
+
+bool ArraySplitter::split(ArraySplit::Position open, size_t parts,
+                          size_t minChunk, ArraySplit &split)
+{
+   minChunk = max<size_t>(minChunk, 1);
+   if (parts < 2 || text.size() - open.offset < 2 * minChunk) {
+      return false;
+   }
+
+   // Note the first comma between elements after every minChunk bytes, and
+   // pick from those once the size of the array is known.
+   vector<ArraySplit::Position> commas;
+   size_t nextComma = open.offset + minChunk;
+   Scanner scanner(text, index, open);
+   int depth = 1;
+   while (depth > 0) {
+      if (!scanner.next()) {
+         return false;
+      }
+      switch (scanner.at()) {
+      case '[':
+      case '{':
+         ++depth;
+         scanner.consume();
+         break;
+      case ']':
+      case '}':
+         if (--depth > 0) {
+            scanner.consume();
+         }
+         break;
+      case ',':
+         if (depth == 1 && scanner.position().offset >= nextComma) {
+            commas.push_back(scanner.position());
+            nextComma = scanner.position().offset + minChunk;
+         }
+         scanner.consume();
+         break;
+      case '#':
+         if (!scanner.skipComment()) {
+            return false;
+         }
+         break;
+      case '"':
+      case '\'':
+         if (!scanner.skipString()) {
+            return false;
+         }
+         break;
+      default:
+         scanner.consume();
+         break;
+      }
+   }
+   split.close = scanner.position();
+
+   // The last run must be at least minChunk bytes too.
+   while (!commas.empty()
+          && split.close.offset - commas.back().offset < minChunk)
+   {
+      commas.pop_back();
+   }
+   if (commas.empty()) {
+      return false;
+   }
+
+   size_t count = min(parts, commas.size() + 1);
+   split.starts.clear();
+   split.starts.push_back(ArraySplit::Position{ open.offset + 1, open.line,
+                                                open.col + 1 });
+   for (size_t i = 1; i < count; ++i) {
+      ArraySplit::Position comma = commas[i * commas.size() / count];
+      split.starts.push_back(ArraySplit::Position{ comma.offset + 1,
+                                                   comma.line,
+                                                   comma.col + 1 });
+   }
+   return true;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef CCM_TOML_ARRAY_SPLIT_H
+#define CCM_TOML_ARRAY_SPLIT_H
+
+#include "structural-index.h"
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+// Where a large array can be split into runs of elements that are parsed on
+// their own (see Parser::parseElements()).
+struct ArraySplit {
+   struct Position {
+      std::size_t offset;
+      int line;
+      int col;
+   };
+
+   // Where each run begins: just after the '[', and then just after each
+   // comma the array is split at. Each run ends where the next one begins.
+   std::vector<Position> starts;
+
+   // The array's closing ']', where the last run ends
+   Position close;
+};
+
+// Finds where large arrays in a document can be split. Arrays must be asked
+// about in the order they appear in the document.
+class ArraySplitter {
+public:
+   explicit ArraySplitter(std::string_view text);
+
+   // Finds the end of the array whose '[' is at `open`, and up to parts - 1
+   // commas between its elements, at least minChunk bytes apart, to split
+   // it at. The array is only scanned as far as brackets, strings and
+   // comments go, so it is checked when the runs are parsed. Returns false
+   // if the array doesn't end or is too small to split.
+   bool split(ArraySplit::Position open, std::size_t parts,
+              std::size_t minChunk, ArraySplit &split);
+
+private:
+   std::string_view text;
+   StructuralIndex index;
+};
+
+}
+
+#endif
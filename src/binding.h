@@ -0,0 +1,555 @@
+#ifndef CCM_TOML_BINDING_H
+#define CCM_TOML_BINDING_H
+
+#include "cell.h"
+#include "date-time.h"
+#include "dotted-key.h"
+#include "exception.h"
+#include "key-index.h"
+#include "reader.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ccm::toml {
+
+// One field of a bound struct: the key it is read from and the member it is
+// stored in.
+template<typename T, typename M>
+struct Field {
+   std::string_view name;
+   M T::*member;
+};
+
+template<typename T, typename M>
+constexpr Field<T, M> field(std::string_view name, M T::*member) {
+   return Field<T, M>{ name, member };
+}
+
+template<typename... F>
+constexpr std::tuple<F...> fields(F... f) {
+   return std::tuple<F...>(f...);
+}
+
+// Binds a struct to the keys of a table by listing its fields once:
+//
+//    struct Server {
+//       std::string host;
+//       std::int64_t port = 80;
+//       std::vector<std::string> tags;
+//    };
+//
+//    template<>
+//    struct ccm::toml::Fields<Server> {
+//       static constexpr auto list = fields(field("host", &Server::host),
+//                                           field("port", &Server::port),
+//                                           field("tags", &Server::tags));
+//    };
+//
+// Members may be strings, integers, floating point numbers (which also accept
+// TOML integers), bools, DateTime, Date, Time, other bound structs (from
+// [sub.tables], dotted keys or inline tables), and std::optional and
+// std::vector of any of these. A std::vector of structs is filled from
+// [[array.tables]] or an array of inline tables. See parseInto().
+template<typename T>
+struct Fields;
+
+namespace detail {
+
+template<typename T, typename = void>
+struct IsBound : std::false_type { };
+
+template<typename T>
+struct IsBound<T, std::void_t<decltype(Fields<T>::list)>> : std::true_type { };
+
+// A perfect hash over a bound struct's key names, found at compile time, that
+// maps each name's hashKey() to a slot of its own. A slot holds the index of
+// the field whose name hashes there, or -1.
+template<unsigned Bits>
+struct PerfectHash {
+   std::uint32_t multiplier = 0;
+   std::array<std::int16_t, std::size_t(1) << Bits> slots{};
+
+   constexpr std::uint32_t slot(std::uint32_t hash) const
+      { return (hash * multiplier) >> (32 - Bits); }
+};
+
+// Multipliers to try for each table size before doubling it
+constexpr std::uint32_t perfectHashTries = 1024;
+
+// Returns the odd multiplier that places every hash in a slot of its own in a
+// table of 2^bits slots, or 0 if none of the ones tried does.
+template<std::size_t N>
+constexpr std::uint32_t findMultiplier(
+                            const std::array<std::uint32_t, N> &hashes,
+                            unsigned bits)
+{
+   std::uint64_t used[(std::size_t(1) << 16) / 64] = {};
+   std::size_t words = ((std::size_t(1) << bits) + 63) / 64;
+   for (std::uint32_t m = 1; m < 2 * perfectHashTries; m += 2) {
+      for (std::size_t w = 0; w < words; ++w) {
+         used[w] = 0;
+      }
+      bool collision = false;
+      for (std::size_t i = 0; i < N && !collision; ++i) {
+         std::uint32_t slot = (hashes[i] * m) >> (32 - bits);
+         collision = (used[slot / 64] >> (slot % 64)) & 1;
+         used[slot / 64] |= std::uint64_t(1) << (slot % 64);
+      }
+      if (!collision) {
+         return m;
+      }
+   }
+   return 0;
+}
+
+// The number of slot bits the perfect hash needs, starting from a table at
+// most half full
+template<std::size_t N>
+constexpr unsigned perfectHashBits(
+                      const std::array<std::uint32_t, N> &hashes)
+{
+   unsigned bits = 1;
+   while ((std::size_t(1) << bits) < 2 * N) {
+      ++bits;
+   }
+   for (; bits <= 16; ++bits) {
+      if (findMultiplier(hashes, bits) != 0) {
+         return bits;
+      }
+   }
+   throw Exception("No perfect hash for these keys; are two the same?");
+}
+
+template<unsigned Bits, std::size_t N>
+constexpr PerfectHash<Bits> makePerfectHash(
+                                 const std::array<std::uint32_t, N> &hashes)
+{
+   PerfectHash<Bits> hash;
+   hash.multiplier = findMultiplier(hashes, Bits);
+   for (auto &slot : hash.slots) {
+      slot = -1;
+   }
+   for (std::size_t i = 0; i < N; ++i) {
+      hash.slots[hash.slot(hashes[i])] = static_cast<std::int16_t>(i);
+   }
+   return hash;
+}
+
+template<typename Reader>
+struct TableOps;
+
+// A bound struct being read into, or nothing
+template<typename Reader>
+struct Target {
+   void *object;
+   const TableOps<Reader> *ops;
+};
+
+// What the binding needs to do with a bound struct without knowing its type.
+// Fields are numbered in the order they are listed.
+template<typename Reader>
+struct TableOps {
+   // Returns the field for the key, or -1 if there is none.
+   int (*find)(const KeySegment &key);
+
+   // Reads field i's value, after the Key event for it.
+   void (*read)(void *object, int i, Reader &reader);
+
+   // Returns the struct in field i that a [header] or dotted key leads
+   // into, or a null Target if the field doesn't hold one. `append` (for the
+   // last key of an [[array.table]] header) adds an element to a std::vector
+   // of structs; otherwise the last element is used.
+   Target<Reader> (*open)(void *object, int i, bool append);
+};
+
+template<typename T, typename Reader>
+const TableOps<Reader> *tableOps();
+
+[[noreturn]] inline void typeMismatch(const DottedKey &key,
+                                      const std::string &expected,
+                                      const char *got)
+{
+   throw SyntaxError("Expected " + expected + " for '"
+                     + std::string(key.back().name) + "', got " + got,
+                     key.line, key.col);
+}
+
+template<typename Reader>
+const char *eventTypeName(const Reader &reader, typename Reader::Event event)
+{
+   using Event = typename Reader::Event;
+   switch (event) {
+   case Event::Value:
+      return typeName(reader.type());
+   case Event::ArrayBegin:
+      return "array";
+   default:
+      return "table";
+   }
+}
+
+// Decode<M>::read() reads a value into M, given the event that begins it.
+template<typename M, typename = void>
+struct Decode;
+
+// Reads a value event of the given TOML type. Ask for it with get().
+template<Type Expected>
+struct DecodeScalar {
+   template<typename Reader, typename M, typename Get>
+   static void read(Reader &reader, typename Reader::Event event, M &out,
+                    Get &&get)
+   {
+      if (event != Reader::Event::Value || reader.type() != Expected) {
+         typeMismatch(reader.key(), typeName(Expected),
+                      eventTypeName(reader, event));
+      }
+      out = get();
+   }
+};
+
+template<>
+struct Decode<std::string> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event,
+                    std::string &out)
+   {
+      DecodeScalar<Type::String>::read(reader, event, out,
+                                       [&] { return reader.asString(); });
+   }
+};
+
+template<>
+struct Decode<bool> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event, bool &out) {
+      DecodeScalar<Type::Boolean>::read(reader, event, out,
+                                        [&] { return reader.asBoolean(); });
+   }
+};
+
+template<typename M>
+struct Decode<M, std::enable_if_t<std::is_integral_v<M>
+                                  && !std::is_same_v<M, bool>>>
+{
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event, M &out) {
+      std::int64_t value = 0;
+      DecodeScalar<Type::Integer>::read(reader, event, value,
+                                        [&] { return reader.asInteger(); });
+      bool fits = std::is_signed_v<M>
+         ? value >= std::numeric_limits<M>::min()
+           && value <= std::numeric_limits<M>::max()
+         : value >= 0
+           && static_cast<std::uint64_t>(value)
+              <= std::numeric_limits<M>::max();
+      if (!fits) {
+         const DottedKey &key = reader.key();
+         throw SyntaxError("Integer out of range for '"
+                           + std::string(key.back().name) + "'",
+                           key.line, key.col);
+      }
+      out = static_cast<M>(value);
+   }
+};
+
+template<typename M>
+struct Decode<M, std::enable_if_t<std::is_floating_point_v<M>>> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event, M &out) {
+      if (event == Reader::Event::Value && reader.type() == Type::Integer) {
+         out = static_cast<M>(reader.asInteger());
+         return;
+      }
+      DecodeScalar<Type::Float>::read(reader, event, out,
+                                      [&] { return reader.asFloat(); });
+   }
+};
+
+template<>
+struct Decode<DateTime> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event,
+                    DateTime &out)
+   {
+      if (event == Reader::Event::Value
+          && reader.type() == Type::OffsetDateTime)
+      {
+         out = reader.asDateTime();
+         return;
+      }
+      DecodeScalar<Type::LocalDateTime>::read(
+         reader, event, out, [&] { return reader.asDateTime(); });
+   }
+};
+
+template<>
+struct Decode<Date> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event, Date &out) {
+      DecodeScalar<Type::LocalDate>::read(reader, event, out,
+                                          [&] { return reader.asDate(); });
+   }
+};
+
+template<>
+struct Decode<Time> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event, Time &out) {
+      DecodeScalar<Type::LocalTime>::read(reader, event, out,
+                                          [&] { return reader.asTime(); });
+   }
+};
+
+template<typename M>
+struct Decode<std::optional<M>> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event,
+                    std::optional<M> &out)
+   {
+      Decode<M>::read(reader, event, out.emplace());
+   }
+};
+
+template<typename M>
+struct Decode<std::vector<M>> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event,
+                    std::vector<M> &out)
+   {
+      if (event != Reader::Event::ArrayBegin) {
+         typeMismatch(reader.key(), "array", eventTypeName(reader, event));
+      }
+      out.clear();
+      for (event = reader.next(); event != Reader::Event::ArrayEnd;
+           event = reader.next())
+      {
+         Decode<M>::read(reader, event, out.emplace_back());
+      }
+   }
+};
+
+template<typename Reader>
+void readKeyValue(Target<Reader> table, Reader &reader);
+
+template<typename M>
+struct Decode<M, std::enable_if_t<IsBound<M>::value>> {
+   template<typename Reader>
+   static void read(Reader &reader, typename Reader::Event event, M &out) {
+      if (event != Reader::Event::InlineTableBegin) {
+         typeMismatch(reader.key(), "table", eventTypeName(reader, event));
+      }
+      Target<Reader> table{ &out, tableOps<M, Reader>() };
+      while (reader.next() == Reader::Event::Key) {
+         readKeyValue(table, reader);
+      }
+   }
+};
+
+// Open<M>::open() returns the struct that a member of type M holds for a
+// header or dotted key to lead into.
+template<typename M, typename = void>
+struct Open {
+   template<typename Reader>
+   static Target<Reader> open(M &, bool)
+      { return Target<Reader>{ nullptr, nullptr }; }
+};
+
+template<typename M>
+struct Open<M, std::enable_if_t<IsBound<M>::value>> {
+   template<typename Reader>
+   static Target<Reader> open(M &member, bool append) {
+      if (append) {
+         return Target<Reader>{ nullptr, nullptr };
+      }
+      return Target<Reader>{ &member, tableOps<M, Reader>() };
+   }
+};
+
+template<typename M>
+struct Open<std::optional<M>, std::enable_if_t<IsBound<M>::value>> {
+   template<typename Reader>
+   static Target<Reader> open(std::optional<M> &member, bool append) {
+      if (!member) {
+         member.emplace();
+      }
+      return Open<M>::template open<Reader>(*member, append);
+   }
+};
+
+template<typename M>
+struct Open<std::vector<M>, std::enable_if_t<IsBound<M>::value>> {
+   template<typename Reader>
+   static Target<Reader> open(std::vector<M> &member, bool append) {
+      if (append) {
+         member.emplace_back();
+      }
+      if (member.empty()) {
+         return Target<Reader>{ nullptr, nullptr };
+      }
+      return Target<Reader>{ &member.back(), tableOps<M, Reader>() };
+   }
+};
+
+// The TableOps of the bound struct T
+template<typename T, typename Reader,
+         typename = std::make_index_sequence<
+            std::tuple_size_v<std::decay_t<decltype(Fields<T>::list)>>>>
+struct Binding;
+
+template<typename T, typename Reader, std::size_t... I>
+struct Binding<T, Reader, std::index_sequence<I...>> {
+   static constexpr auto &list = Fields<T>::list;
+
+   static_assert(sizeof...(I) > 0, "a bound struct needs fields");
+   static_assert(sizeof...(I) <= std::numeric_limits<std::int16_t>::max(),
+                 "too many fields");
+
+   static constexpr std::array<std::string_view, sizeof...(I)> names = {
+      std::get<I>(list).name...
+   };
+   static constexpr std::array<std::uint32_t, sizeof...(I)> hashes = {
+      hashKey(std::get<I>(list).name)...
+   };
+   static constexpr unsigned bits = perfectHashBits(hashes);
+   static constexpr PerfectHash<bits> perfectHash
+      = makePerfectHash<bits>(hashes);
+
+   static int find(const KeySegment &key) {
+      int i = perfectHash.slots[perfectHash.slot(key.hash)];
+      return i >= 0 && names[i] == key.name ? i : -1;
+   }
+
+   template<std::size_t J>
+   static void readField(void *object, Reader &reader) {
+      auto &member = static_cast<T *>(object)->*std::get<J>(list).member;
+      using M = std::decay_t<decltype(member)>;
+      Decode<M>::read(reader, reader.next(), member);
+   }
+
+   template<std::size_t J>
+   static Target<Reader> openField(void *object, bool append) {
+      auto &member = static_cast<T *>(object)->*std::get<J>(list).member;
+      using M = std::decay_t<decltype(member)>;
+      return Open<M>::template open<Reader>(member, append);
+   }
+
+   static void read(void *object, int i, Reader &reader) {
+      static constexpr void (*readers[])(void *, Reader &) = {
+         &readField<I>...
+      };
+      readers[i](object, reader);
+   }
+
+   static Target<Reader> open(void *object, int i, bool append) {
+      static constexpr Target<Reader> (*openers[])(void *, bool) = {
+         &openField<I>...
+      };
+      return openers[i](object, append);
+   }
+
+   static constexpr TableOps<Reader> ops = { &find, &read, &open };
+};
+
+template<typename T, typename Reader>
+const TableOps<Reader> *tableOps() {
+   return &Binding<T, Reader>::ops;
+}
+
+// Follows key[i] from the struct `table`. Returns a null Target if the key
+// isn't one of its fields, and throws if the field holds no struct.
+template<typename Reader>
+Target<Reader> openKey(Target<Reader> table, const DottedKey &key,
+                       std::size_t i, bool append)
+{
+   int field = table.ops->find(key[i]);
+   if (field < 0) {
+      return Target<Reader>{ nullptr, nullptr };
+   }
+   Target<Reader> next = table.ops->open(table.object, field, append);
+   if (!next.object) {
+      throw SyntaxError("'" + std::string(key[i].name) + "' is not "
+                        + (append ? "an array of tables" : "a table"),
+                        key.line, key.col);
+   }
+   return next;
+}
+
+// Follows the key from the struct `table`, except for its last part if the
+// key is a dotted key. Returns a null Target if the key leads somewhere the
+// struct has no field for.
+template<typename Reader>
+Target<Reader> resolve(Target<Reader> table, const DottedKey &key,
+                       std::size_t count, bool append)
+{
+   for (std::size_t i = 0; i < count && table.object; ++i) {
+      table = openKey(table, key, i, append && i + 1 == key.size());
+   }
+   return table;
+}
+
+// Reads the key/value pair at a Key event into the struct `table`, skipping
+// it if the struct has no field for it.
+template<typename Reader>
+void readKeyValue(Target<Reader> table, Reader &reader) {
+   const DottedKey &key = reader.key();
+   table = resolve(table, key, key.size() - 1, false);
+   int field = table.object ? table.ops->find(key.back()) : -1;
+   if (field < 0) {
+      reader.skip();
+      return;
+   }
+   table.ops->read(table.object, field, reader);
+}
+
+}
+
+// Reads a whole document from `reader` into the bound struct `out` (see
+// Fields), with no Document in between. Keys and tables that `out` has no
+// fields for are skipped without being decoded. The rules about defining keys
+// and tables only once are not enforced; a key that is given twice keeps its
+// last value.
+template<typename T, typename Reader>
+void bind(Reader &reader, T &out) {
+   static_assert(detail::IsBound<T>::value, "T needs a Fields<T>");
+
+   using Event = typename Reader::Event;
+   detail::Target<Reader> root{ &out, detail::tableOps<T, Reader>() };
+   detail::Target<Reader> table = root;
+   while (true) {
+      Event event = reader.next();
+      switch (event) {
+      case Event::End:
+         return;
+      case Event::TableHeader:
+      case Event::ArrayTableHeader:
+         {
+            const DottedKey &key = reader.key();
+            bool append = event == Event::ArrayTableHeader;
+            table = detail::resolve(root, key, key.size(), append);
+            if (!table.object) {
+               reader.skip();
+            }
+            break;
+         }
+      case Event::Key:
+         detail::readKeyValue(table, reader);
+         break;
+      default:
+         throw Exception("bind(): unexpected event");
+      }
+   }
+}
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef CCM_TOML_BUFFER_SOURCE_H
+#define CCM_TOML_BUFFER_SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace ccm::toml {
+
+// An input source over a contiguous, caller-owned buffer. Reading is a pointer
+// bump and peeking is an index, so there is no copying or refilling at all.
+// The buffer must outlive the source.
+//
+// Because the whole input is addressable, the Tokenizer hands out tokens whose
+// lexemes are views into the buffer (see position() and slice()).
+class BufferSource {
+public:
+   BufferSource(std::string_view input)
+      : begin(input.data()),
+        cur(input.data()),
+        end(input.data() + input.size())
+      { }
+
+   BufferSource(const char *data, std::size_t size)
+      : BufferSource(std::string_view(data, size))
+      { }
+
+   int get() {
+      if (cur == end) {
+         return std::char_traits<char>::eof();
+      }
+      return static_cast<unsigned char>(*cur++);
+   }
+
+   int peek(std::size_t index=0) const {
+      if (index >= static_cast<std::size_t>(end - cur)) {
+         return std::char_traits<char>::eof();
+      }
+      return static_cast<unsigned char>(cur[index]);
+   }
+
+   // Offset of the next unconsumed character from the start of the buffer.
+   std::size_t position() const
+      { return cur - begin; }
+
+   std::size_t size() const
+      { return end - begin; }
+
+   // Consumes n characters, which must be available.
+   void advance(std::size_t n)
+      { cur += n; }
+
+   std::string_view slice(std::size_t from, std::size_t to) const
+      { return std::string_view(begin + from, to - from); }
+
+private:
+   const char *begin;
+   const char *cur;
+   const char *end;
+};
+
+}
+
+#endif
\ No newline at end of file
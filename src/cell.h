@@ -0,0 +1,151 @@
+#ifndef CCM_TOML_CELL_H
+#define CCM_TOML_CELL_H
+
+#include "date-time.h"
+#include "key-index.h"
+
+#include <cstdint>
+#include <string_view>
+
+namespace ccm::toml {
+
+enum class Type : std::uint8_t {
+   Table,
+   Array,
+   String,
+   Integer,
+   Float,
+   Boolean,
+   OffsetDateTime,
+   LocalDateTime,
+   LocalDate,
+   LocalTime
+};
+
+const char *typeName(Type type);
+
+namespace detail {
+
+// A run of characters in a document's string pool, or in a shared
+// StringPool if the offset has sharedStringBit set
+struct StringRef {
+   std::uint32_t offset;
+   std::uint32_t length;
+};
+
+constexpr std::uint32_t sharedStringBit = std::uint32_t(1) << 31;
+
+// A run of cells. The members of a table and the elements of an array are
+// stored next to each other.
+struct CellRange {
+   std::uint32_t first;
+   std::uint32_t count;
+};
+
+// One value of a frozen document, tagged with its type. Scalars are stored
+// inline, strings and containers refer to the document's pools, and dates
+// and times are packed into `packed` with their nanoseconds in `extra`.
+struct Cell {
+   union {
+      std::int64_t integer;
+      double floating;
+      bool boolean;
+      std::uint64_t packed;
+      StringRef string;
+      CellRange range;
+   };
+   std::uint32_t extra;
+   Type type;
+};
+
+static_assert(sizeof(Cell) == 16, "cells should stay compact");
+
+// Bit layout of Cell::packed for dates and times. The parser rejects dates
+// and times with out-of-range fields, so they all fit.
+//
+//    0-13   year            28-33  minute          41     offset is negative
+//    14-17  month           34-39  second          42-46  offset hours
+//    18-22  day             40     has an offset   47-52  offset minutes
+//    23-27  hour
+inline std::uint64_t pack(const Date &date) {
+   return static_cast<std::uint64_t>(date.year)
+          | static_cast<std::uint64_t>(date.month) << 14
+          | static_cast<std::uint64_t>(date.day) << 18;
+}
+
+inline std::uint64_t pack(const Time &time) {
+   return static_cast<std::uint64_t>(time.hour) << 23
+          | static_cast<std::uint64_t>(time.minute) << 28
+          | static_cast<std::uint64_t>(time.second) << 34;
+}
+
+inline std::uint64_t pack(const DateTime &dateTime) {
+   std::uint64_t packed = pack(dateTime.date) | pack(dateTime.time);
+   if (dateTime.offset) {
+      packed |= std::uint64_t(1) << 40
+                | static_cast<std::uint64_t>(dateTime.offset->negative) << 41
+                | static_cast<std::uint64_t>(dateTime.offset->hours) << 42
+                | static_cast<std::uint64_t>(dateTime.offset->minutes) << 47;
+   }
+   return packed;
+}
+
+inline Date unpackDate(std::uint64_t packed) {
+   Date date;
+   date.year = packed & 0x3FFF;
+   date.month = (packed >> 14) & 0xF;
+   date.day = (packed >> 18) & 0x1F;
+   return date;
+}
+
+inline Time unpackTime(std::uint64_t packed, std::uint32_t nanosecond) {
+   Time time;
+   time.hour = (packed >> 23) & 0x1F;
+   time.minute = (packed >> 28) & 0x3F;
+   time.second = (packed >> 34) & 0x3F;
+   time.nanosecond = nanosecond;
+   return time;
+}
+
+inline DateTime unpackDateTime(std::uint64_t packed,
+                               std::uint32_t nanosecond)
+{
+   DateTime dateTime;
+   dateTime.date = unpackDate(packed);
+   dateTime.time = unpackTime(packed, nanosecond);
+   if ((packed >> 40) & 1) {
+      dateTime.offset = DateTime::Offset{};
+      dateTime.offset->negative = (packed >> 41) & 1;
+      dateTime.offset->hours = (packed >> 42) & 0x1F;
+      dateTime.offset->minutes = (packed >> 47) & 0x3F;
+   }
+   return dateTime;
+}
+
+// A frozen document: every value's cell, the key of each cell that is a
+// table member (parallel to cells), the characters of all keys and strings,
+// and the hash indexes of tables with more than linearScanLimit keys. A
+// table's index starts at index[cell.extra] and has
+// indexCapacity(range.count) slots. Cell 0 is the root table. `shared` is
+// the data of the document's StringPool, if it has one.
+struct Storage {
+   const Cell *cells;
+   const StringRef *keys;
+   const char *strings;
+   const IndexSlot *index;
+   const char *shared;
+
+   std::string_view string(StringRef ref) const {
+      if (ref.offset & sharedStringBit) {
+         return std::string_view(shared + (ref.offset & ~sharedStringBit),
+                                 ref.length);
+      }
+      return std::string_view(strings + ref.offset, ref.length);
+   }
+};
+
+}
+
+}
+
+#endif
\ No newline at end of file
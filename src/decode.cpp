@@ -0,0 +1,153 @@
+#include "decode.h"
+
+#include "exception.h"
+#include "utf8.h"
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+// Decodes the escape sequences in the characters of a basic string. A
+// backslash at the end of a line trims all whitespace and newlines after it.
+string_view decodeString(string_view raw, string &buf) {
+   buf.clear();
+   for (size_t i = 0; i < raw.size(); ++i) {
+      char c = raw[i];
+      if (c != '\\') {
+         buf += c;
+         continue;
+      }
+
+      c = raw[++i];
+      switch (c) {
+      case 'b':
+         buf += '\b';
+         break;
+      case 't':
+         buf += '\t';
+         break;
+      case 'n':
+         buf += '\n';
+         break;
+      case 'f':
+         buf += '\f';
+         break;
+      case 'r':
+         buf += '\r';
+         break;
+      case 'u':
+      case 'U':
+         {
+            // The Tokenizer checked the digits and the value.
+            uint32_t code = 0;
+            for (int n = c == 'u' ? 4 : 8; n > 0; --n) {
+               code = code << 4 | utf8::hexValue(raw[++i]);
+            }
+            char bytes[4];
+            buf.append(bytes, utf8::encode(code, bytes));
+            break;
+         }
+      case '\r':
+      case '\n':
+         while (i + 1 < raw.size()
+                && (raw[i + 1] == ' ' || raw[i + 1] == '\t'
+                    || raw[i + 1] == '\r' || raw[i + 1] == '\n'))
+         {
+            ++i;
+         }
+         break;
+      default:
+         // '"' and '\\'
+         buf += c;
+      }
+   }
+   return buf;
+}
+
+// Copies text into buf without its underscores, if it has any.
+string_view stripUnderscores(string_view text, string &buf) {
+   if (text.find('_') == string_view::npos) {
+      return text;
+   }
+   buf.clear();
+   for (char c : text) {
+      if (c != '_') {
+         buf += c;
+      }
+   }
+   return buf;
+}
+
+int64_t decodeInteger(const Token &token, string &buf) {
+   string_view text = token.lexeme;
+   bool negative = text[0] == '-';
+   if (text[0] == '+' || text[0] == '-') {
+      text.remove_prefix(1);
+   }
+
+   int base = 10;
+   if (text.size() > 1 && text[0] == '0'
+       && (text[1] == 'b' || text[1] == 'o' || text[1] == 'x'))
+   {
+      base = text[1] == 'b' ? 2 : text[1] == 'o' ? 8 : 16;
+      text.remove_prefix(2);
+   }
+   text = stripUnderscores(text, buf);
+
+   uint64_t magnitude = 0;
+   auto result = from_chars(text.data(), text.data() + text.size(), magnitude,
+                            base);
+   uint64_t limit = numeric_limits<int64_t>::max();
+   if (result.ec != errc{} || magnitude > limit + (negative && base == 10)) {
+      throw SyntaxError("Integer overflows 64 bits", token.line, token.col);
+   }
+   return static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+}
+
+double decodeFloat(const Token &token, string &buf) {
+   string_view text = token.lexeme;
+   bool negative = text[0] == '-';
+   if (text[0] == '+' || text[0] == '-') {
+      text.remove_prefix(1);
+   }
+   text = stripUnderscores(text, buf);
+
+   double value = 0;
+   auto result = from_chars(text.data(), text.data() + text.size(), value);
+   if (result.ec == errc::result_out_of_range) {
+      throw SyntaxError("Floating point overflow/underflow",
+                        token.line, token.col);
+   }
+   else if (result.ec != errc{}) {
+      throw Exception("Could not parse floating point number");
+   }
+   return negative ? -value : value;
+}
+
+}
+
+Token::Value decodeValue(const Token &token, string &buf) {
+   if (!token.deferred) {
+      return token.value;
+   }
+
+   switch (token.kind) {
+   case Token::Kind::String:
+      return decodeString(get<string_view>(token.value), buf);
+   case Token::Kind::Integer:
+      return decodeInteger(token, buf);
+   case Token::Kind::Float:
+      return decodeFloat(token, buf);
+   default:
+      return token.value;
+   }
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef CCM_TOML_DECODE_H
+#define CCM_TOML_DECODE_H
+
+#include "token.h"
+
+#include <string>
+
+namespace ccm::toml {
+
+// Decodes the value of a token whose decoding the Tokenizer deferred (see
+// Tokenizer::lazy()). The Tokenizer has already checked the token's syntax,
+// so the only error left to report is a number that is out of range, which
+// throws SyntaxError at the token's position. Strings are decoded into buf,
+// which the result views. Tokens that aren't deferred return their value.
+Token::Value decodeValue(const Token &token, std::string &buf);
+
+}
+
+#endif
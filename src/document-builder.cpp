@@ -0,0 +1,673 @@
+#include "document-builder.h"
+
+#include "exception.h"
+
+#include <cstring>
+#include <limits>
+#include <new>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+using detail::ArrayNode;
+using detail::Cell;
+using detail::CellRange;
+using detail::IndexSlot;
+using detail::Node;
+using detail::StringId;
+using detail::StringRef;
+using detail::TableNode;
+
+template<typename T, typename... Args>
+T *create(pmr::memory_resource *resource, Args &&...args) {
+   void *p = resource->allocate(sizeof(T), alignof(T));
+   return new (p) T(forward<Args>(args)...);
+}
+
+template<typename T>
+T *allocateArray(pmr::memory_resource *resource, size_t n) {
+   return static_cast<T *>(resource->allocate(n ? n * sizeof(T) : 1,
+                                              alignof(T)));
+}
+
+// Measures a tree of nodes so the Document can be allocated in one go.
+struct Size {
+   size_t cells = 0;
+   size_t indexSlots = 0;
+
+   void add(const TableNode *table) {
+      cells += table->entries.size();
+      indexSlots += table->index.size();
+      for (const auto &entry : table->entries) {
+         add(entry.value);
+      }
+   }
+
+   void add(const ArrayNode *array) {
+      cells += array->elements.size();
+      for (const Node &node : array->elements) {
+         add(node);
+      }
+   }
+
+   void add(const Node &node) {
+      if (auto *table = get_if<TableNode *>(&node)) {
+         add(*table);
+      }
+      else if (auto *array = get_if<ArrayNode *>(&node)) {
+         add(*array);
+      }
+   }
+};
+
+// Copies a tree of nodes into cells. The cells for the members of a table
+// (or elements of an array) are reserved together before any of them are
+// filled in, so that each container's contents are contiguous. `strings`
+// gives the final location of each string ID.
+class Freezer {
+public:
+   Freezer(Cell *cells, StringRef *keys, IndexSlot *index,
+           const StringRef *strings)
+      : cells(cells),
+        keys(keys),
+        index(index),
+        strings(strings)
+      { }
+
+   void freeze(const TableNode *table, Cell &cell) {
+      CellRange range = reserve(table->entries.size());
+      cell.type = Type::Table;
+      cell.range = range;
+
+      // The index refers to keys by their position in the table, so it can
+      // be copied as it is. `extra` says where it starts.
+      cell.extra = indexSize;
+      if (!table->index.empty()) {
+         memcpy(index + indexSize, table->index.data(),
+                table->index.size() * sizeof(IndexSlot));
+         indexSize += table->index.size();
+      }
+
+      for (uint32_t i = 0; i < range.count; ++i) {
+         const TableNode::Entry &entry = table->entries[i];
+         keys[range.first + i] = strings[entry.key];
+         freeze(entry.value, cells[range.first + i]);
+      }
+   }
+
+   void freeze(const ArrayNode *array, Cell &cell) {
+      CellRange range = reserve(array->elements.size());
+      cell.type = Type::Array;
+      cell.extra = 0;
+      cell.range = range;
+      for (uint32_t i = 0; i < range.count; ++i) {
+         keys[range.first + i] = StringRef{ 0, 0 };
+         freeze(array->elements[i], cells[range.first + i]);
+      }
+   }
+
+   void freeze(const Node &node, Cell &cell) {
+      cell.extra = 0;
+      switch (node.index()) {
+      case 0:
+         freeze(get<TableNode *>(node), cell);
+         break;
+      case 1:
+         freeze(get<ArrayNode *>(node), cell);
+         break;
+      case 2:
+         cell.type = Type::String;
+         cell.string = strings[get<StringId>(node).id];
+         break;
+      case 3:
+         cell.type = Type::Integer;
+         cell.integer = get<int64_t>(node);
+         break;
+      case 4:
+         cell.type = Type::Float;
+         cell.floating = get<double>(node);
+         break;
+      case 5:
+         cell.type = Type::Boolean;
+         cell.packed = 0;
+         cell.boolean = get<bool>(node);
+         break;
+      case 6:
+         {
+            const DateTime &dateTime = get<DateTime>(node);
+            cell.type = dateTime.offset ? Type::OffsetDateTime
+                                        : Type::LocalDateTime;
+            cell.packed = detail::pack(dateTime);
+            cell.extra = dateTime.time.nanosecond;
+            break;
+         }
+      case 7:
+         cell.type = Type::LocalDate;
+         cell.packed = detail::pack(get<Date>(node));
+         break;
+      case 8:
+         {
+            const Time &time = get<Time>(node);
+            cell.type = Type::LocalTime;
+            cell.packed = detail::pack(time);
+            cell.extra = time.nanosecond;
+            break;
+         }
+      }
+   }
+
+private:
+   CellRange reserve(size_t n) {
+      CellRange range{ next, static_cast<uint32_t>(n) };
+      next += range.count;
+      return range;
+   }
+
+   Cell *cells;
+   StringRef *keys;
+   IndexSlot *index;
+   const StringRef *strings;
+
+   // The root table's members start at cell 1.
+   uint32_t next = 1;
+   uint32_t indexSize = 0;
+};
+
+// Changes a tree's string IDs from one builder's to another's, where ids[i]
+// is the new ID of string i.
+void renumber(Node &node, const vector<uint32_t> &ids);
+
+void renumber(TableNode *table, const vector<uint32_t> &ids) {
+   for (TableNode::Entry &entry : table->entries) {
+      entry.key = ids[entry.key];
+      renumber(entry.value, ids);
+   }
+}
+
+void renumber(Node &node, const vector<uint32_t> &ids) {
+   if (auto *table = get_if<TableNode *>(&node)) {
+      renumber(*table, ids);
+   }
+   else if (auto *array = get_if<ArrayNode *>(&node)) {
+      for (Node &element : (*array)->elements) {
+         renumber(element, ids);
+      }
+   }
+   else if (auto *string = get_if<StringId>(&node)) {
+      string->id = ids[string->id];
+   }
+}
+
+bool mergeTable(TableNode *into, TableNode *from);
+
+// Merges a member of a table from a later part of the document into the
+// member with the same key, following the rules for headers: a table
+// created as a prefix leads into any table that isn't inline, or into the
+// last table of an array of tables; a table defined by a header defines one
+// that was only created as a prefix; and arrays of tables are appended to.
+// Anything else is defined twice.
+bool mergeEntry(Node &into, const Node &from) {
+   using Origin = TableNode::Origin;
+
+   if (auto *table = get_if<TableNode *>(&from)) {
+      auto *t = get_if<TableNode *>(&into);
+      auto *a = get_if<ArrayNode *>(&into);
+      switch ((*table)->origin) {
+      case Origin::Implicit:
+         if (t && (*t)->origin != Origin::Inline) {
+            return mergeTable(*t, *table);
+         }
+         if (a && (*a)->ofTables) {
+            return mergeTable(get<TableNode *>((*a)->elements.back()),
+                              *table);
+         }
+         return false;
+      case Origin::Header:
+         if (t && (*t)->origin == Origin::Implicit) {
+            (*t)->origin = Origin::Header;
+            return mergeTable(*t, *table);
+         }
+         return false;
+      default:
+         return false;
+      }
+   }
+
+   auto *array = get_if<ArrayNode *>(&from);
+   auto *a = get_if<ArrayNode *>(&into);
+   if (array && (*array)->ofTables && a && (*a)->ofTables) {
+      (*a)->elements.insert((*a)->elements.end(),
+                            (*array)->elements.begin(),
+                            (*array)->elements.end());
+      return true;
+   }
+   return false;
+}
+
+bool mergeTable(TableNode *into, TableNode *from) {
+   for (const TableNode::Entry &entry : from->entries) {
+      Node *existing = into->find(entry.key, entry.hash);
+      if (!existing) {
+         into->insert(entry.key, entry.hash, entry.value);
+      }
+      else if (!mergeEntry(*existing, entry.value)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+}
+
+namespace detail {
+
+Node *TableNode::find(uint32_t key, uint32_t hash) {
+   if (index.empty()) {
+      for (Entry &entry : entries) {
+         if (entry.key == key) {
+            return &entry.value;
+         }
+      }
+      return nullptr;
+   }
+
+   int64_t i = indexFind(index.data(), index.size(), key, hash,
+                         [&](uint32_t i) { return entries[i].key; });
+   return i < 0 ? nullptr : &entries[i].value;
+}
+
+void TableNode::insert(uint32_t key, uint32_t hash, const Node &value) {
+   entries.push_back(Entry{ key, hash, value });
+   uint32_t count = entries.size();
+   if (count <= linearScanLimit) {
+      return;
+   }
+
+   if (index.empty()) {
+      // Index the keys that were scanned linearly until now.
+      for (uint32_t i = 0; i + 1 < count; ++i) {
+         indexAdd(index, i + 1, IndexSlot{ entries[i].hash, i + 1 });
+      }
+   }
+   indexAdd(index, count, IndexSlot{ hash, count });
+}
+
+}
+
+DocumentBuilder::DocumentBuilder(pmr::memory_resource *upstream,
+                                 shared_ptr<StringPool> shared,
+                                 pmr::memory_resource *scratchUpstream)
+   : upstream(upstream),
+     scratch(scratchUpstream ? scratchUpstream : upstream),
+     rootNode(newTable(TableNode::Origin::Header)),
+     frames(&scratch),
+     pool(&scratch),
+     refs(&scratch),
+     interned(&scratch),
+     shared(move(shared))
+{
+   frames.push_back(Frame{ rootNode, nullptr, nullptr, 0, 0 });
+}
+
+void DocumentBuilder::onTableHeader(const DottedKey &key) {
+   TableNode *parent = rootNode;
+   for (size_t i = 0; i + 1 < key.size(); ++i) {
+      parent = descendHeader(parent, key[i], key);
+   }
+
+   const KeySegment &last = key.back();
+   uint32_t id = intern(last.name, last.hash);
+   Node *existing = parent->find(id, last.hash);
+   TableNode *table;
+   if (!existing) {
+      table = newTable(Origin::Header);
+      parent->insert(id, last.hash, table);
+   }
+   else if (auto *t = get_if<TableNode *>(existing);
+            t && (*t)->origin == Origin::Implicit)
+   {
+      // [a.b] followed by [a] defines a
+      table = *t;
+      table->origin = Origin::Header;
+   }
+   else {
+      throw SyntaxError("Redefinition of '" + string(last.name) + "'",
+                        key.line, key.col);
+   }
+   frames.front().table = table;
+}
+
+void DocumentBuilder::onArrayTableHeader(const DottedKey &key) {
+   TableNode *parent = rootNode;
+   for (size_t i = 0; i + 1 < key.size(); ++i) {
+      parent = descendHeader(parent, key[i], key);
+   }
+
+   const KeySegment &last = key.back();
+   uint32_t id = intern(last.name, last.hash);
+   Node *existing = parent->find(id, last.hash);
+   ArrayNode *array;
+   if (!existing) {
+      array = newArray(true);
+      parent->insert(id, last.hash, array);
+   }
+   else if (auto *a = get_if<ArrayNode *>(existing); a && (*a)->ofTables) {
+      array = *a;
+   }
+   else {
+      throw SyntaxError("Redefinition of '" + string(last.name) + "'",
+                        key.line, key.col);
+   }
+
+   TableNode *table = newTable(Origin::Header);
+   array->elements.emplace_back(table);
+   frames.front().table = table;
+}
+
+void DocumentBuilder::onKey(const DottedKey &key) {
+   Frame &frame = frames.back();
+   TableNode *parent = frame.table;
+   for (size_t i = 0; i + 1 < key.size(); ++i) {
+      parent = descendDotted(parent, key[i], key);
+   }
+
+   const KeySegment &last = key.back();
+   uint32_t id = intern(last.name, last.hash);
+   if (parent->find(id, last.hash)) {
+      throw SyntaxError("Duplicate key '" + string(last.name) + "'",
+                        key.line, key.col);
+   }
+   frame.parent = parent;
+   frame.key = id;
+   frame.hash = last.hash;
+}
+
+void DocumentBuilder::onArrayBegin() {
+   ArrayNode *array = newArray(false);
+   place(array);
+   frames.push_back(Frame{ nullptr, array, nullptr, 0, 0 });
+}
+
+void DocumentBuilder::onArrayEnd() {
+   frames.pop_back();
+}
+
+void DocumentBuilder::onInlineTableBegin() {
+   TableNode *table = newTable(Origin::Inline);
+   place(table);
+   frames.push_back(Frame{ table, nullptr, nullptr, 0, 0 });
+}
+
+void DocumentBuilder::onInlineTableEnd() {
+   frames.pop_back();
+}
+
+detail::TableNode *DocumentBuilder::newTable(Origin origin) {
+   return create<TableNode>(&scratch, origin, &scratch);
+}
+
+detail::ArrayNode *DocumentBuilder::newArray(bool ofTables) {
+   return create<ArrayNode>(&scratch, ofTables, &scratch);
+}
+
+// Adds a value to the innermost open container.
+void DocumentBuilder::place(const Node &value) {
+   Frame &frame = frames.back();
+   if (frame.array) {
+      frame.array->elements.push_back(value);
+   }
+   else {
+      frame.parent->insert(frame.key, frame.hash, value);
+   }
+}
+
+// Finds or creates the table `segment` in `parent` for a prefix of a [table]
+// or [[array]] header. Arrays of tables resolve to their last table.
+detail::TableNode *DocumentBuilder::descendHeader(TableNode *parent,
+                                                  const KeySegment &segment,
+                                                  const DottedKey &key)
+{
+   uint32_t id = intern(segment.name, segment.hash);
+   Node *existing = parent->find(id, segment.hash);
+   if (!existing) {
+      TableNode *child = newTable(Origin::Implicit);
+      parent->insert(id, segment.hash, child);
+      return child;
+   }
+   if (auto *t = get_if<TableNode *>(existing);
+       t && (*t)->origin != Origin::Inline)
+   {
+      return *t;
+   }
+   if (auto *a = get_if<ArrayNode *>(existing); a && (*a)->ofTables) {
+      return get<TableNode *>((*a)->elements.back());
+   }
+   throw SyntaxError("'" + string(segment.name) + "' is not a table",
+                     key.line, key.col);
+}
+
+// Finds or creates the table `segment` in `parent` for a prefix of a dotted
+// key. Dotted keys can only add to tables that dotted keys created.
+detail::TableNode *DocumentBuilder::descendDotted(TableNode *parent,
+                                                  const KeySegment &segment,
+                                                  const DottedKey &key)
+{
+   uint32_t id = intern(segment.name, segment.hash);
+   Node *existing = parent->find(id, segment.hash);
+   if (!existing) {
+      TableNode *child = newTable(Origin::Dotted);
+      parent->insert(id, segment.hash, child);
+      return child;
+   }
+   if (auto *t = get_if<TableNode *>(existing);
+       t && (*t)->origin == Origin::Dotted)
+   {
+      return *t;
+   }
+   throw SyntaxError("Cannot add keys to '" + string(segment.name) + "'",
+                     key.line, key.col);
+}
+
+detail::StringId DocumentBuilder::newString(string_view s) {
+   if (s.size() <= internLimit) {
+      return StringId{ intern(s, detail::hashKey(s)) };
+   }
+   return StringId{ append(s) };
+}
+
+uint32_t DocumentBuilder::intern(string_view s, uint32_t hash) {
+   if (!interned.empty()) {
+      int64_t found = detail::indexFind(interned.data(), interned.size(), s,
+                                        hash, [&](uint32_t id) {
+                                           return stringAt(id);
+                                        });
+      if (found >= 0) {
+         return found;
+      }
+   }
+
+   uint32_t id = append(s);
+   ++internedCount;
+   detail::indexAdd(interned, internedCount, IndexSlot{ hash, id + 1 });
+   return id;
+}
+
+uint32_t DocumentBuilder::append(string_view s) {
+   if (refs.size() >= numeric_limits<uint32_t>::max()
+       || pool.size() + s.size() > numeric_limits<uint32_t>::max())
+   {
+      throw Exception("DocumentBuilder: the document is too large");
+   }
+   StringRef ref{ static_cast<uint32_t>(pool.size()),
+                  static_cast<uint32_t>(s.size()) };
+   pool.insert(pool.end(), s.begin(), s.end());
+   refs.push_back(ref);
+   return refs.size() - 1;
+}
+
+bool DocumentBuilder::merge(DocumentBuilder &other) {
+   renumber(other.rootNode, adoptStrings(other));
+   return mergeTable(rootNode, other.rootNode);
+}
+
+bool DocumentBuilder::mergeCopy(const DocumentBuilder &other) {
+   vector<uint32_t> ids = adoptStrings(other);
+   return mergeTable(rootNode, get<TableNode *>(copy(other.rootNode, ids)));
+}
+
+void DocumentBuilder::beginElements() {
+   elements = newArray(false);
+   frames.push_back(Frame{ nullptr, elements, nullptr, 0, 0 });
+}
+
+void DocumentBuilder::appendElements(
+   const vector<unique_ptr<DocumentBuilder>> &parts)
+{
+   ArrayNode *array = frames.back().array;
+   size_t count = array->elements.size();
+   for (const auto &part : parts) {
+      count += part->elements->elements.size();
+   }
+   array->elements.reserve(count);
+
+   for (const auto &part : parts) {
+      vector<uint32_t> ids = adoptStrings(*part);
+      for (Node &node : part->elements->elements) {
+         renumber(node, ids);
+         array->elements.push_back(node);
+      }
+   }
+}
+
+// Gives each of other's strings an ID here, interning the ones it interned,
+// and returns the new IDs by their IDs in `other`.
+vector<uint32_t> DocumentBuilder::adoptStrings(const DocumentBuilder &other) {
+   vector<uint32_t> ids(other.refs.size());
+   vector<bool> isInterned(other.refs.size(), false);
+   for (const IndexSlot &slot : other.interned) {
+      if (slot.entry != 0) {
+         uint32_t id = slot.entry - 1;
+         isInterned[id] = true;
+         ids[id] = intern(other.stringAt(id), slot.hash);
+      }
+   }
+   for (uint32_t id = 0; id < other.refs.size(); ++id) {
+      if (!isInterned[id]) {
+         ids[id] = append(other.stringAt(id));
+      }
+   }
+   return ids;
+}
+
+// Copies a tree of another builder's nodes into the scratch arena, where
+// ids[i] is the ID here of that builder's string i. Table indexes refer to
+// keys by position and hash, so they are copied as they are.
+detail::Node DocumentBuilder::copy(const Node &node,
+                                   const vector<uint32_t> &ids)
+{
+   if (auto *table = get_if<TableNode *>(&node)) {
+      TableNode *to = newTable((*table)->origin);
+      to->entries.reserve((*table)->entries.size());
+      for (const TableNode::Entry &entry : (*table)->entries) {
+         to->entries.push_back(TableNode::Entry{ ids[entry.key], entry.hash,
+                                                 copy(entry.value, ids) });
+      }
+      to->index.assign((*table)->index.begin(), (*table)->index.end());
+      return to;
+   }
+   if (auto *array = get_if<ArrayNode *>(&node)) {
+      ArrayNode *to = newArray((*array)->ofTables);
+      to->elements.reserve((*array)->elements.size());
+      for (const Node &element : (*array)->elements) {
+         to->elements.push_back(copy(element, ids));
+      }
+      return to;
+   }
+   if (auto *string = get_if<StringId>(&node)) {
+      return StringId{ ids[string->id] };
+   }
+   return node;
+}
+
+Document DocumentBuilder::finish() {
+   Size size;
+   size.add(rootNode);
+   // Plus one for the root table itself
+   size_t cellCount = size.cells + 1;
+
+   // Decide where each string goes. Without a shared pool, the builder's
+   // pool is copied as it is. Otherwise interned strings go to the shared
+   // pool and only the rest are copied.
+   pmr::vector<StringRef> placed(&scratch);
+   size_t stringBytes = pool.size();
+   if (shared) {
+      pmr::vector<bool> isInterned(refs.size(), false, &scratch);
+      for (const IndexSlot &slot : interned) {
+         if (slot.entry != 0) {
+            isInterned[slot.entry - 1] = true;
+         }
+      }
+
+      placed.resize(refs.size());
+      stringBytes = 0;
+      StringPool::Session session(*shared);
+      for (uint32_t id = 0; id < refs.size(); ++id) {
+         if (isInterned[id]) {
+            uint32_t offset = session.intern(stringAt(id),
+                                             detail::hashKey(stringAt(id)));
+            placed[id] = StringRef{ offset | detail::sharedStringBit,
+                                    refs[id].length };
+         }
+         else {
+            placed[id] = StringRef{ static_cast<uint32_t>(stringBytes),
+                                    refs[id].length };
+            stringBytes += refs[id].length;
+         }
+      }
+   }
+
+   if (cellCount > numeric_limits<uint32_t>::max()
+       || stringBytes >= detail::sharedStringBit
+       || size.indexSlots > numeric_limits<uint32_t>::max())
+   {
+      throw Exception("DocumentBuilder::finish(): the document is too large");
+   }
+
+   // Size the arena's first block to hold everything.
+   size_t bytes = sizeof(detail::Storage) + cellCount * sizeof(Cell)
+                  + cellCount * sizeof(StringRef) + stringBytes
+                  + size.indexSlots * sizeof(IndexSlot) + 64;
+   auto arena = make_unique<pmr::monotonic_buffer_resource>(bytes, upstream);
+
+   Cell *cells = allocateArray<Cell>(arena.get(), cellCount);
+   StringRef *keys = allocateArray<StringRef>(arena.get(), cellCount);
+   IndexSlot *index = allocateArray<IndexSlot>(arena.get(), size.indexSlots);
+   char *strings = allocateArray<char>(arena.get(), stringBytes);
+
+   if (shared) {
+      for (uint32_t id = 0; id < refs.size(); ++id) {
+         if (!(placed[id].offset & detail::sharedStringBit)) {
+            memcpy(strings + placed[id].offset, pool.data() + refs[id].offset,
+                   refs[id].length);
+         }
+      }
+   }
+   else if (!pool.empty()) {
+      memcpy(strings, pool.data(), pool.size());
+   }
+
+   Freezer freezer(cells, keys, index, shared ? placed.data() : refs.data());
+   keys[0] = StringRef{ 0, 0 };
+   freezer.freeze(rootNode, cells[0]);
+
+   auto *storage = create<detail::Storage>(
+      arena.get(),
+      detail::Storage{ cells, keys, strings, index,
+                       shared ? shared->data() : nullptr });
+   return Document(move(arena), storage, move(shared));
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,232 @@
+#ifndef CCM_TOML_DOCUMENT_BUILDER_H
+#define CCM_TOML_DOCUMENT_BUILDER_H
+
+#include "date-time.h"
+#include "document.h"
+#include "dotted-key.h"
+#include "key-index.h"
+#include "string-pool.h"
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace ccm::toml {
+
+namespace detail {
+
+struct TableNode;
+struct ArrayNode;
+
+// A string stored by a DocumentBuilder. Interned strings that are equal have
+// the same ID.
+struct StringId {
+   std::uint32_t id;
+};
+
+// Local and offset date-times are both DateTimes, told apart by the offset.
+using Node = std::variant<TableNode *,
+                          ArrayNode *,
+                          StringId,
+                          std::int64_t,
+                          double,
+                          bool,
+                          DateTime,
+                          Date,
+                          Time>;
+
+// Nodes live in the builder's scratch arena along with everything they point
+// to. They are never destroyed; the arena releases all of their memory at
+// once.
+struct TableNode {
+   // How the table came to be, which decides how it may be added to later.
+   enum class Origin : std::uint8_t {
+      // Created as a prefix of a [table] header, e.g. `a` in [a.b]
+      Implicit,
+      // Defined by a [table] or [[array]] header
+      Header,
+      // Created by a dotted key, e.g. `a` in a.b = 1
+      Dotted,
+      // An inline table, which cannot be added to once it is closed
+      Inline
+   };
+
+   // Keys are interned, so they are compared by ID.
+   struct Entry {
+      std::uint32_t key;
+      std::uint32_t hash;
+      Node value;
+   };
+
+   TableNode(Origin origin, std::pmr::memory_resource *resource)
+      : entries(resource),
+        index(resource),
+        origin(origin)
+      { }
+
+   // `key` is an interned key and `hash` is its hashKey().
+   Node *find(std::uint32_t key, std::uint32_t hash);
+   void insert(std::uint32_t key, std::uint32_t hash, const Node &value);
+
+   // In insertion (source) order
+   std::pmr::vector<Entry> entries;
+
+   // Empty until the table outgrows linearScanLimit
+   std::pmr::vector<IndexSlot> index;
+
+   Origin origin;
+};
+
+struct ArrayNode {
+   ArrayNode(bool ofTables, std::pmr::memory_resource *resource)
+      : elements(resource),
+        ofTables(ofTables)
+      { }
+
+   std::pmr::vector<Node> elements;
+
+   // Created by [[array]] headers rather than as a value
+   bool ofTables;
+};
+
+}
+
+// Builds a Document from a Parser's events, enforcing the rules about
+// defining keys and tables only once. TOML allows adding to a table long
+// after it first appears, so while parsing, tables and arrays are linked
+// nodes in a scratch arena. finish() copies them into the Document's compact
+// layout in one pass, and the scratch memory is released with the builder.
+//
+// Keys, and string values of up to internLimit characters, are interned:
+// each distinct one is stored once however often it appears, and tables
+// compare keys by ID. Given a shared StringPool, finish() moves the interned
+// strings there, so that documents parsed with the same pool share them.
+class DocumentBuilder {
+public:
+   static constexpr std::size_t internLimit = 64;
+
+   // The scratch arena gets its memory from scratchUpstream if it is given,
+   // and otherwise from `upstream`, as the finished Document's arena does. A
+   // pool resource that outlives many builders lets them reuse the memory.
+   explicit DocumentBuilder(std::pmr::memory_resource *upstream
+                               = std::pmr::get_default_resource(),
+                            std::shared_ptr<StringPool> shared = nullptr,
+                            std::pmr::memory_resource *scratchUpstream
+                               = nullptr);
+
+   DocumentBuilder(const DocumentBuilder &) = delete;
+   DocumentBuilder &operator=(const DocumentBuilder &) = delete;
+
+   // Parser events. These throw SyntaxError for keys and tables that are
+   // defined twice.
+   void onTableHeader(const DottedKey &key);
+   void onArrayTableHeader(const DottedKey &key);
+   void onKey(const DottedKey &key);
+   void onValue(std::string_view s)
+      { place(newString(s)); }
+   void onValue(std::int64_t value)
+      { place(value); }
+   void onValue(double value)
+      { place(value); }
+   void onValue(bool value)
+      { place(value); }
+   void onValue(const DateTime &value)
+      { place(value); }
+   void onValue(const Date &value)
+      { place(value); }
+   void onValue(const Time &value)
+      { place(value); }
+   void onArrayBegin();
+   void onArrayEnd();
+   void onInlineTableBegin();
+   void onInlineTableEnd();
+
+   // Adds what `other` built from a later part of the same document, which
+   // began with a [table] or [[array]] header, as if this builder had parsed
+   // that part itself. Returns false if the parts define something twice,
+   // leaving this builder unusable. `other`'s tables and arrays are taken
+   // over rather than copied, so it must outlive finish().
+   bool merge(DocumentBuilder &other);
+
+   // Like merge(), but copies other's tables and arrays rather than taking
+   // them over, so that `other` is left as it was and can be merged again
+   // into another builder later.
+   bool mergeCopy(const DocumentBuilder &other);
+
+   // For building some of a large array's elements on their own: the values
+   // that follow go into an array of their own rather than a table.
+   void beginElements();
+
+   // Appends the elements each of `parts` built after beginElements(), in
+   // order, to the array begun by the last onArrayBegin(). As with merge(),
+   // the parts' nodes are taken over, so they must outlive finish().
+   void appendElements(
+      const std::vector<std::unique_ptr<DocumentBuilder>> &parts);
+
+   // Throws Exception if the document is too large to lay out (more than
+   // 2^32 values, 2 GiB of strings or 2^32 index slots).
+   Document finish();
+
+private:
+   using TableNode = detail::TableNode;
+   using ArrayNode = detail::ArrayNode;
+   using Node = detail::Node;
+   using Origin = TableNode::Origin;
+
+   // An open container that values go into: the table that key/value pairs
+   // currently go into, or an array or inline table being parsed. For
+   // tables, `parent` and `key` say where the next value goes, as set by
+   // onKey().
+   struct Frame {
+      TableNode *table;
+      ArrayNode *array;
+      TableNode *parent;
+      std::uint32_t key;
+      std::uint32_t hash;
+   };
+
+   TableNode *newTable(Origin origin);
+   ArrayNode *newArray(bool ofTables);
+   detail::StringId newString(std::string_view s);
+
+   std::string_view stringAt(std::uint32_t id) const {
+      detail::StringRef ref = refs[id];
+      return std::string_view(pool.data() + ref.offset, ref.length);
+   }
+
+   void place(const Node &value);
+   TableNode *descendHeader(TableNode *parent, const KeySegment &segment,
+                            const DottedKey &key);
+   TableNode *descendDotted(TableNode *parent, const KeySegment &segment,
+                            const DottedKey &key);
+   std::uint32_t intern(std::string_view s, std::uint32_t hash);
+   std::uint32_t append(std::string_view s);
+   std::vector<std::uint32_t> adoptStrings(const DocumentBuilder &other);
+   Node copy(const Node &node, const std::vector<std::uint32_t> &ids);
+
+   std::pmr::memory_resource *upstream;
+   std::pmr::monotonic_buffer_resource scratch;
+   TableNode *rootNode;
+
+   // The array begun by beginElements(), if any
+   ArrayNode *elements = nullptr;
+
+   // frames[0] is the table that key/value pairs currently go into.
+   std::pmr::vector<Frame> frames;
+
+   // The characters of every string, where refs[id] is the string with that
+   // ID, and an index of the interned ones.
+   std::pmr::vector<char> pool;
+   std::pmr::vector<detail::StringRef> refs;
+   std::pmr::vector<detail::IndexSlot> interned;
+   std::uint32_t internedCount = 0;
+
+   std::shared_ptr<StringPool> shared;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "document.h"
+
+#include "exception.h"
+
+#include <string>
+
+using namespace std;
+
+namespace ccm::toml {
+
+const char *typeName(Type type) {
+   switch (type) {
+   case Type::Table:
+      return "table";
+   case Type::Array:
+      return "array";
+   case Type::String:
+      return "string";
+   case Type::Integer:
+      return "integer";
+   case Type::Float:
+      return "float";
+   case Type::Boolean:
+      return "boolean";
+   case Type::OffsetDateTime:
+      return "offset date-time";
+   case Type::LocalDateTime:
+      return "local date-time";
+   case Type::LocalDate:
+      return "local date";
+   case Type::LocalTime:
+      return "local time";
+   }
+   return "unknown";
+}
+
+Type Value::type() const {
+   if (!cell) {
+      throw Exception("Value::type(): the value does not exist");
+   }
+   return cell->type;
+}
+
+const detail::Cell &Value::expect(Type expected) const {
+   if (!cell) {
+      throw Exception(string("Expected ") + typeName(expected)
+                      + ", but the value does not exist");
+   }
+   if (cell->type != expected) {
+      throw Exception(string("Expected ") + typeName(expected) + ", got "
+                      + typeName(cell->type));
+   }
+   return *cell;
+}
+
+string_view Value::asString() const {
+   return storage->string(expect(Type::String).string);
+}
+
+int64_t Value::asInteger() const {
+   return expect(Type::Integer).integer;
+}
+
+double Value::asFloat() const {
+   return expect(Type::Float).floating;
+}
+
+bool Value::asBoolean() const {
+   return expect(Type::Boolean).boolean;
+}
+
+DateTime Value::asDateTime() const {
+   if (is(Type::OffsetDateTime)) {
+      return detail::unpackDateTime(cell->packed, cell->extra);
+   }
+   const detail::Cell &local = expect(Type::LocalDateTime);
+   return detail::unpackDateTime(local.packed, local.extra);
+}
+
+Date Value::asDate() const {
+   return detail::unpackDate(expect(Type::LocalDate).packed);
+}
+
+Time Value::asTime() const {
+   const detail::Cell &time = expect(Type::LocalTime);
+   return detail::unpackTime(time.packed, time.extra);
+}
+
+Table Value::asTable() const {
+   return Table(storage, expect(Type::Table));
+}
+
+Array Value::asArray() const {
+   return Array(storage, expect(Type::Array).range);
+}
+
+Value Value::operator[](string_view key) const {
+   if (is(Type::Table)) {
+      return Table(storage, *cell)[key];
+   }
+   return Value();
+}
+
+Value Value::operator[](const KeySegment &key) const {
+   if (is(Type::Table)) {
+      return Table(storage, *cell)[key];
+   }
+   return Value();
+}
+
+Value Value::operator[](size_t index) const {
+   if (is(Type::Array)) {
+      return Array(storage, cell->range)[index];
+   }
+   return Value();
+}
+
+const detail::Cell *Table::find(string_view key) const {
+   if (range.count <= detail::linearScanLimit) {
+      return scan(key);
+   }
+   return find(key, detail::hashKey(key));
+}
+
+// `hash` is hashKey(key).
+const detail::Cell *Table::find(string_view key, uint32_t hash) const {
+   if (range.count <= detail::linearScanLimit) {
+      return scan(key);
+   }
+
+   auto keyAt = [&](uint32_t i) {
+      return storage->string(storage->keys[range.first + i]);
+   };
+   int64_t i = detail::indexFind(storage->index + indexStart,
+                                 detail::indexCapacity(range.count), key,
+                                 hash, keyAt);
+   return i < 0 ? nullptr : storage->cells + range.first + i;
+}
+
+const detail::Cell *Table::scan(string_view key) const {
+   for (uint32_t i = 0; i < range.count; ++i) {
+      if (storage->string(storage->keys[range.first + i]) == key) {
+         return storage->cells + range.first + i;
+      }
+   }
+   return nullptr;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,252 @@
+#ifndef CCM_TOML_DOCUMENT_H
+#define CCM_TOML_DOCUMENT_H
+
+#include "cell.h"
+#include "date-time.h"
+#include "dotted-key.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+
+namespace ccm::toml {
+
+class StringPool;
+
+class Table;
+class Array;
+
+// A read-only handle to a value in a Document. Handles are cheap to copy and
+// remain valid for as long as the Document does. A default-constructed Value
+// refers to nothing; lookups return one when the key or index doesn't exist,
+// so that they can be chained: doc["servers"]["alpha"]["ip"].
+class Value {
+public:
+   Value() = default;
+
+   explicit operator bool() const
+      { return cell != nullptr; }
+
+   Type type() const;
+   bool is(Type t) const
+      { return cell && cell->type == t; }
+
+   // These throw Exception if the value is missing or has a different type.
+   std::string_view asString() const;
+   std::int64_t asInteger() const;
+   double asFloat() const;
+   bool asBoolean() const;
+   // Offset or local date-time
+   DateTime asDateTime() const;
+   Date asDate() const;
+   Time asTime() const;
+   Table asTable() const;
+   Array asArray() const;
+
+   // Return an empty Value if this isn't a table (or array) or the key (or
+   // index) doesn't exist.
+   Value operator[](std::string_view key) const;
+   Value operator[](std::size_t index) const;
+   // Looks up a key whose hash is already known (see Query)
+   Value operator[](const KeySegment &key) const;
+
+private:
+   friend class Table;
+   friend class Array;
+   friend class KeyHandle;
+
+   Value(const detail::Storage *storage, const detail::Cell *cell)
+      : storage(storage),
+        cell(cell)
+      { }
+
+   const detail::Cell &expect(Type expected) const;
+
+   const detail::Storage *storage = nullptr;
+   const detail::Cell *cell = nullptr;
+};
+
+class Table {
+public:
+   struct Entry {
+      std::string_view key;
+      Value value;
+   };
+
+   class Iterator {
+   public:
+      Entry operator*() const {
+         return Entry{ storage->string(storage->keys[index]),
+                       Value(storage, storage->cells + index) };
+      }
+
+      Iterator &operator++()
+         { ++index; return *this; }
+
+      bool operator==(const Iterator &other) const
+         { return index == other.index; }
+      bool operator!=(const Iterator &other) const
+         { return index != other.index; }
+
+   private:
+      friend class Table;
+
+      Iterator(const detail::Storage *storage, std::uint32_t index)
+         : storage(storage),
+           index(index)
+         { }
+
+      const detail::Storage *storage;
+      std::uint32_t index;
+   };
+
+   std::size_t size() const
+      { return range.count; }
+   bool empty() const
+      { return range.count == 0; }
+
+   bool contains(std::string_view key) const
+      { return find(key) != nullptr; }
+
+   // Returns an empty Value if the key doesn't exist.
+   Value operator[](std::string_view key) const {
+      const detail::Cell *cell = find(key);
+      return cell ? Value(storage, cell) : Value();
+   }
+   Value operator[](const KeySegment &key) const {
+      const detail::Cell *cell = find(key.name, key.hash);
+      return cell ? Value(storage, cell) : Value();
+   }
+
+   // Iterates in the order the keys appear in the source.
+   Iterator begin() const
+      { return Iterator(storage, range.first); }
+   Iterator end() const
+      { return Iterator(storage, range.first + range.count); }
+
+private:
+   friend class Value;
+   friend class Document;
+
+   Table(const detail::Storage *storage, const detail::Cell &cell)
+      : storage(storage),
+        range(cell.range),
+        indexStart(cell.extra)
+      { }
+
+   const detail::Cell *find(std::string_view key) const;
+   const detail::Cell *find(std::string_view key, std::uint32_t hash) const;
+   const detail::Cell *scan(std::string_view key) const;
+
+   const detail::Storage *storage;
+   detail::CellRange range;
+   std::uint32_t indexStart;
+};
+
+class Array {
+public:
+   class Iterator {
+   public:
+      Value operator*() const
+         { return Value(storage, cell); }
+
+      Iterator &operator++()
+         { ++cell; return *this; }
+
+      bool operator==(const Iterator &other) const
+         { return cell == other.cell; }
+      bool operator!=(const Iterator &other) const
+         { return cell != other.cell; }
+
+   private:
+      friend class Array;
+
+      Iterator(const detail::Storage *storage, const detail::Cell *cell)
+         : storage(storage),
+           cell(cell)
+         { }
+
+      const detail::Storage *storage;
+      const detail::Cell *cell;
+   };
+
+   std::size_t size() const
+      { return range.count; }
+   bool empty() const
+      { return range.count == 0; }
+
+   // Returns an empty Value if the index is out of range.
+   Value operator[](std::size_t index) const {
+      return index < range.count
+             ? Value(storage, storage->cells + range.first + index)
+             : Value();
+   }
+
+   Iterator begin() const
+      { return Iterator(storage, storage->cells + range.first); }
+   Iterator end() const {
+      return Iterator(storage, storage->cells + range.first + range.count);
+   }
+
+private:
+   friend class Value;
+
+   Array(const detail::Storage *storage, detail::CellRange range)
+      : storage(storage),
+        range(range)
+      { }
+
+   const detail::Storage *storage;
+   detail::CellRange range;
+};
+
+// A parsed TOML document. It is immutable, and laid out compactly: each value
+// is one 16-byte cell, the members of each table and the elements of each
+// array are adjacent cells, and all keys and strings share one pool. All of
+// this lives in a monotonic arena that belongs to the document, and
+// destroying the document releases it at once. The arena gets its memory
+// from the `upstream` resource passed to parse(), which callers can use to
+// plug in their own allocation strategy. A document parsed with a shared
+// StringPool keeps its interned strings there and holds on to the pool.
+//
+// Documents are built by DocumentBuilder.
+class Document {
+public:
+   Document(Document &&other) noexcept = default;
+   Document &operator=(Document &&other) noexcept = default;
+
+   Table root() const
+      { return Table(storage, storage->cells[0]); }
+
+   Value operator[](std::string_view key) const
+      { return root()[key]; }
+
+   // The arena. Memory allocated from it lives as long as the document.
+   std::pmr::memory_resource *resource() const
+      { return arena.get(); }
+
+private:
+   friend class DocumentBuilder;
+   friend class KeyHandle;
+   friend class LiveDocument;
+
+   Document(std::unique_ptr<std::pmr::monotonic_buffer_resource> arena,
+            const detail::Storage *storage,
+            std::shared_ptr<const StringPool> strings)
+      : arena(std::move(arena)),
+        storage(storage),
+        strings(std::move(strings))
+      { }
+
+   // The storage is allocated in the arena, which is on the heap, so moving a
+   // Document leaves handles to it valid.
+   std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+   const detail::Storage *storage;
+   std::shared_ptr<const StringPool> strings;
+};
+
+}
+
+#endif
\ No newline at end of file
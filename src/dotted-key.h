@@ -0,0 +1,40 @@
+#ifndef CCM_TOML_DOTTED_KEY_H
+#define CCM_TOML_DOTTED_KEY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ccm::toml {
+
+// One segment of a key, with its hashKey()
+struct KeySegment {
+   std::string_view name;
+   std::uint32_t hash;
+};
+
+// A simple or dotted key as the parser reports it to a handler, with the
+// position of its first character. It and the names it refers to are only
+// valid during the call.
+struct DottedKey {
+   const KeySegment *segments;
+   std::size_t count;
+   int line;
+   int col;
+
+   std::size_t size() const
+      { return count; }
+   const KeySegment &operator[](std::size_t i) const
+      { return segments[i]; }
+   const KeySegment &back() const
+      { return segments[count - 1]; }
+
+   const KeySegment *begin() const
+      { return segments; }
+   const KeySegment *end() const
+      { return segments + count; }
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "fd-source.h"
+
+#include "exception.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace ccm::toml {
+
+FdSource::FdSource(int fd)
+   : fd(fd)
+{
+}
+
+size_t FdSource::read(char *out, size_t size) {
+   while (true) {
+      ssize_t n = ::read(fd, out, size);
+      if (n >= 0) {
+         return n;
+      }
+      if (errno != EINTR) {
+         throw Exception(string("FdSource: read() failed: ")
+                         + strerror(errno));
+      }
+   }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef CCM_TOML_FD_SOURCE_H
+#define CCM_TOML_FD_SOURCE_H
+
+#include "ring-source.h"
+
+#include <cstddef>
+
+namespace ccm::toml {
+
+// An input source that reads a POSIX file descriptor in large read(2) blocks
+// into a ring buffer (see RingSource). The descriptor is not owned and is not
+// closed.
+class FdSource : public RingSource<FdSource> {
+public:
+   static constexpr const char *name = "FdSource";
+
+   FdSource(int fd);
+
+private:
+   friend class RingSource<FdSource>;
+
+   std::size_t read(char *out, std::size_t size);
+
+   int fd;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "incremental.h"
+
+#include "buffer-source.h"
+#include "document-builder.h"
+#include "exception.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+using BufferTokenizer = Tokenizer<0, BufferSource>;
+
+// Returns where the line `back` lines before the one containing `pos`
+// starts.
+size_t lineStart(string_view text, size_t pos, int back) {
+   while (pos > 0) {
+      size_t newline = text.rfind('\n', pos - 1);
+      if (newline == string_view::npos) {
+         return 0;
+      }
+      if (back-- == 0) {
+         return newline + 1;
+      }
+      pos = newline;
+   }
+   return 0;
+}
+
+int countLines(string_view text) {
+   return static_cast<int>(count(text.begin(), text.end(), '\n'));
+}
+
+}
+
+// Passes a Parser's events on to a builder for each section, beginning a new
+// section at each top-level header that follows anything else.
+class IncrementalDocument::Recorder {
+public:
+   Recorder(const IncrementalDocument &doc, const BufferTokenizer &tokenizer,
+            string_view text, vector<Section> &sections, size_t start,
+            int line)
+      : doc(doc),
+        tokenizer(tokenizer),
+        text(text),
+        sections(sections)
+   {
+      begin(start, line);
+   }
+
+   void onTableHeader(const DottedKey &key)
+      { header(key).onTableHeader(key); }
+   void onArrayTableHeader(const DottedKey &key)
+      { header(key).onArrayTableHeader(key); }
+   void onKey(const DottedKey &key)
+      { builder().onKey(key); }
+   template<typename T>
+   void onValue(const T &value)
+      { builder().onValue(value); }
+   void onArrayBegin()
+      { builder().onArrayBegin(); }
+   void onArrayEnd()
+      { builder().onArrayEnd(); }
+   void onInlineTableBegin()
+      { builder().onInlineTableBegin(); }
+   void onInlineTableEnd()
+      { builder().onInlineTableEnd(); }
+
+private:
+   void begin(size_t start, int line) {
+      auto next = make_unique<DocumentBuilder>(doc.upstream, doc.strings);
+      sections.push_back(Section{ start, line, move(next) });
+      empty = true;
+   }
+
+   DocumentBuilder &builder() {
+      empty = false;
+      return *sections.back().builder;
+   }
+
+   // The Tokenizer has read the header's closing bracket, and perhaps more,
+   // so the header's line is found by counting back from where it is.
+   DocumentBuilder &header(const DottedKey &key) {
+      if (!empty) {
+         begin(lineStart(text, tokenizer.position(),
+                         tokenizer.line() - key.line),
+               key.line);
+      }
+      return builder();
+   }
+
+   const IncrementalDocument &doc;
+   const BufferTokenizer &tokenizer;
+   string_view text;
+   vector<Section> &sections;
+
+   // True until the current section has had an event
+   bool empty;
+};
+
+IncrementalDocument::IncrementalDocument(string text,
+                                         pmr::memory_resource *upstream,
+                                         shared_ptr<StringPool> strings)
+   : upstream(upstream),
+     strings(move(strings))
+{
+   reload(move(text));
+}
+
+IncrementalDocument::~IncrementalDocument() = default;
+
+void IncrementalDocument::edit(size_t offset, size_t length,
+                               string_view replacement)
+{
+   if (offset > source.size() || length > source.size() - offset) {
+      throw Exception("IncrementalDocument::edit(): the range is out of "
+                      "bounds");
+   }
+   tokenized = 0;
+
+   string text = source;
+   text.replace(offset, length, replacement);
+
+   // Parse again from the last section that starts before the edit (the
+   // text before it is unchanged, so it still starts at a header) to the
+   // end of the section that the edit ends in (which ended with a newline
+   // that the edit didn't touch).
+   auto byStart = [](const Section &section, size_t pos) {
+      return section.start < pos;
+   };
+   size_t first = lower_bound(sections.begin(), sections.end(), offset,
+                              byStart) - sections.begin();
+   first = first > 0 ? first - 1 : 0;
+   size_t next = lower_bound(sections.begin(), sections.end(),
+                             offset + length + 1, byStart) - sections.begin();
+
+   ptrdiff_t shift = replacement.size() - length;
+   int lines = countLines(replacement)
+               - countLines(string_view(source).substr(offset, length));
+   size_t end = next < sections.size() ? sections[next].start + shift
+                                       : text.size();
+
+   vector<Section> edited;
+   try {
+      parseSections(text, sections[first].start, sections[first].line, end,
+                    edited);
+   }
+   catch (const SyntaxError &) {
+      reload(move(text));
+      return;
+   }
+
+   vector<DocumentBuilder *> builders;
+   for (size_t i = 0; i < first; ++i) {
+      builders.push_back(sections[i].builder.get());
+   }
+   for (const Section &section : edited) {
+      builders.push_back(section.builder.get());
+   }
+   for (size_t i = next; i < sections.size(); ++i) {
+      builders.push_back(sections[i].builder.get());
+   }
+   Snapshot doc;
+   if (!assemble(builders, doc)) {
+      reload(move(text));
+      return;
+   }
+
+   for (size_t i = next; i < sections.size(); ++i) {
+      sections[i].start += shift;
+      sections[i].line += lines;
+   }
+   sections.erase(sections.begin() + first, sections.begin() + next);
+   sections.insert(sections.begin() + first,
+                   make_move_iterator(edited.begin()),
+                   make_move_iterator(edited.end()));
+   source = move(text);
+   current = move(doc);
+}
+
+// Parses text[start, end), which begins a section at `line`, into sections.
+// Throws SyntaxError if that part of the text is malformed on its own.
+void IncrementalDocument::parseSections(string_view text, size_t start,
+                                        int line, size_t end,
+                                        vector<Section> &out)
+{
+   BufferTokenizer tokenizer(text.substr(0, end));
+   tokenizer.seek(start, line, 1);
+   Recorder recorder(*this, tokenizer, text, out, start, line);
+   tokenized += end - start;
+   Parser<BufferTokenizer, Recorder>(tokenizer, recorder).parse();
+}
+
+// Merges copies of what the builders built, in order. Returns false if they
+// define something twice. A lone builder, which has always just been
+// parsed, is finished as it is; that leaves its nodes as they were.
+bool IncrementalDocument::assemble(const vector<DocumentBuilder *> &builders,
+                                   Snapshot &out) const
+{
+   if (builders.size() == 1) {
+      out = Snapshot(builders[0]->finish());
+      return true;
+   }
+
+   DocumentBuilder builder(upstream, strings);
+   for (DocumentBuilder *section : builders) {
+      if (!builder.mergeCopy(*section)) {
+         return false;
+      }
+   }
+   out = Snapshot(builder.finish());
+   return true;
+}
+
+// Divides the whole text into sections anew.
+void IncrementalDocument::reload(string text) {
+   vector<Section> all;
+   Snapshot doc;
+   bool parsed = false;
+   try {
+      parseSections(text, 0, 1, text.size(), all);
+      vector<DocumentBuilder *> builders;
+      for (const Section &section : all) {
+         builders.push_back(section.builder.get());
+      }
+      parsed = assemble(builders, doc);
+   }
+   catch (const SyntaxError &) {
+   }
+
+   if (!parsed) {
+      // Parsed a section at a time, a key defined twice can go unnoticed
+      // until after a later error, so the text is parsed in one go to find
+      // the error parse() would report.
+      all.clear();
+      all.push_back(Section{
+         0, 1, make_unique<DocumentBuilder>(upstream, strings) });
+      BufferTokenizer tokenizer(text);
+      tokenized += text.size();
+      Parser<BufferTokenizer, DocumentBuilder>(tokenizer, *all[0].builder)
+         .parse();
+      assemble({ all[0].builder.get() }, doc);
+   }
+
+   sections = move(all);
+   source = move(text);
+   current = move(doc);
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef CCM_TOML_INCREMENTAL_H
+#define CCM_TOML_INCREMENTAL_H
+
+#include "snapshot.h"
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+class DocumentBuilder;
+class StringPool;
+
+// A document kept up to date as its text is edited, for editors and reload
+// paths that change a line or two of a large file at a time.
+//
+// The text is divided into sections, each beginning at the line of a
+// top-level [table] or [[array]] header (the first at the start), and each
+// section keeps the builder it was parsed with. A header line is a safe
+// place to start parsing again: nothing is open there and a key or header
+// comes next. An edit tokenizes only the sections it touches, starting at
+// the last header before it, and the sections after them are the same as
+// before. The document is then assembled by merging copies of every
+// section's tables, which is much cheaper than tokenizing, and laid out
+// anew.
+//
+// If the edited sections don't parse on their own, for instance because the
+// edit opens a multi-line string that runs into the sections after it, or
+// if they conflict with the others, the whole text is parsed again, so that
+// errors are reported exactly as parse() would report them.
+//
+// Keeping the builders costs about as much memory again as parsing took.
+class IncrementalDocument {
+public:
+   // Throws SyntaxError if the text is malformed.
+   explicit IncrementalDocument(std::string text,
+                                std::pmr::memory_resource *upstream
+                                   = std::pmr::get_default_resource(),
+                                std::shared_ptr<StringPool> strings
+                                   = nullptr);
+   IncrementalDocument(const IncrementalDocument &) = delete;
+   IncrementalDocument &operator=(const IncrementalDocument &) = delete;
+   ~IncrementalDocument();
+
+   const std::string &text() const
+      { return source; }
+
+   // The document as of the last edit. Copies of it stay valid after later
+   // edits.
+   const Snapshot &snapshot() const
+      { return current; }
+
+   // Replaces `length` bytes of the text at `offset` with `replacement`.
+   // Throws SyntaxError, with its position in the edited text, if that is
+   // malformed, and Exception if the range is out of bounds; either way the
+   // text and document stay as they were.
+   void edit(std::size_t offset, std::size_t length,
+             std::string_view replacement);
+
+   // How many bytes of text the constructor or the last edit tokenized
+   std::size_t reparsed() const
+      { return tokenized; }
+
+private:
+   struct Section {
+      // Where the section starts in the text, at the beginning of a line,
+      // and that line's number
+      std::size_t start;
+      int line;
+      std::unique_ptr<DocumentBuilder> builder;
+   };
+
+   class Recorder;
+
+   void parseSections(std::string_view text, std::size_t start, int line,
+                      std::size_t end, std::vector<Section> &out);
+   bool assemble(const std::vector<DocumentBuilder *> &builders,
+                 Snapshot &out) const;
+   void reload(std::string text);
+
+   std::pmr::memory_resource *upstream;
+   std::shared_ptr<StringPool> strings;
+
+   std::string source;
+   std::vector<Section> sections;
+   Snapshot current;
+   std::size_t tokenized = 0;
+};
+
+}
+
+#endif
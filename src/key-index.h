@@ -0,0 +1,142 @@
+#ifndef CCM_TOML_KEY_INDEX_H
+#define CCM_TOML_KEY_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+namespace ccm::toml::detail {
+
+// Tables with at most this many keys are searched linearly. Larger ones get
+// a hash index.
+constexpr std::uint32_t linearScanLimit = 8;
+
+// Reads n <= 8 bytes at p as one word, as memcpy into a zeroed word would.
+// The byte-at-a-time path only runs in constant expressions.
+constexpr std::uint64_t loadKeyWord(const char *p, std::size_t n) {
+   std::uint64_t v = 0;
+   if (__builtin_is_constant_evaluated()) {
+      for (std::size_t i = 0; i < n; ++i) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+         int shift = 8 * (7 - i);
+#else
+         int shift = 8 * i;
+#endif
+         v |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i]))
+              << shift;
+      }
+   }
+   else {
+      std::memcpy(&v, p, n);
+   }
+   return v;
+}
+
+// Usable at compile time, so that the hashes of keys known in advance can be
+// computed then (see Fields).
+constexpr std::uint32_t hashKey(std::string_view key) {
+   const char *p = key.data();
+   std::size_t n = key.size();
+   std::uint64_t h = 0x9E3779B97F4A7C15 ^ n;
+   auto mix = [&](std::uint64_t v) {
+      h = (h ^ v) * 0xBF58476D1CE4E5B9;
+      h ^= h >> 31;
+   };
+   for (; n >= 8; p += 8, n -= 8) {
+      mix(loadKeyWord(p, 8));
+   }
+   if (n > 0) {
+      mix(loadKeyWord(p, n));
+   }
+   h *= 0x94D049BB133111EB;
+   return static_cast<std::uint32_t>(h ^ (h >> 32));
+}
+
+// A slot of an open-addressing (Robin Hood) index over a table's keys. Each
+// slot caches its key's hash, so probes rarely touch the keys themselves and
+// the index can be rebuilt without rehashing. `entry` is the position of the
+// key in the table (in source order) plus one, or 0 for an empty slot.
+struct IndexSlot {
+   std::uint32_t hash;
+   std::uint32_t entry;
+};
+
+// The number of slots for a table of `count` keys: a power of two, at most
+// 80% full. It depends only on the count, so it need not be stored.
+inline std::uint32_t indexCapacity(std::uint32_t count) {
+   std::uint32_t capacity = 16;
+   while (static_cast<std::uint64_t>(count) * 5
+          > static_cast<std::uint64_t>(capacity) * 4)
+   {
+      capacity *= 2;
+   }
+   return capacity;
+}
+
+// Returns the position of `key` in the table, or -1 if it isn't there.
+// keyAt(i) returns the key at position i; keys may be strings or anything
+// else that compares equal when the strings do, such as interned IDs.
+template<typename Key, typename KeyAt>
+std::int64_t indexFind(const IndexSlot *slots, std::uint32_t capacity,
+                       const Key &key, std::uint32_t hash, KeyAt &&keyAt)
+{
+   std::uint32_t mask = capacity - 1;
+   std::uint32_t i = hash & mask;
+   for (std::uint32_t distance = 0; ; ++distance, i = (i + 1) & mask) {
+      const IndexSlot &slot = slots[i];
+      // Robin Hood insertion keeps every key closer to its home slot than
+      // any key it was displaced by, so once we pass a key nearer to home
+      // than we are, ours isn't there.
+      if (slot.entry == 0 || ((i - slot.hash) & mask) < distance) {
+         return -1;
+      }
+      if (slot.hash == hash && keyAt(slot.entry - 1) == key) {
+         return slot.entry - 1;
+      }
+   }
+}
+
+// Adds a slot. There must be a free slot.
+inline void indexInsert(IndexSlot *slots, std::uint32_t capacity,
+                        IndexSlot slot)
+{
+   std::uint32_t mask = capacity - 1;
+   std::uint32_t i = slot.hash & mask;
+   for (std::uint32_t distance = 0; ; ++distance, i = (i + 1) & mask) {
+      if (slots[i].entry == 0) {
+         slots[i] = slot;
+         return;
+      }
+      std::uint32_t existing = (i - slots[i].hash) & mask;
+      if (existing < distance) {
+         // Take from the rich: the resident is nearer home, so it moves on.
+         IndexSlot displaced = slots[i];
+         slots[i] = slot;
+         slot = displaced;
+         distance = existing;
+      }
+   }
+}
+
+// Adds a slot to an index that will then hold `count` slots, first growing
+// it if that many need more room. The cached hashes are reused to grow it.
+template<typename Vector>
+void indexAdd(Vector &index, std::uint32_t count, IndexSlot slot) {
+   std::uint32_t capacity = indexCapacity(count);
+   if (index.size() != capacity) {
+      Vector old(std::move(index));
+      index.assign(capacity, IndexSlot{ 0, 0 });
+      for (const IndexSlot &s : old) {
+         if (s.entry != 0) {
+            indexInsert(index.data(), capacity, s);
+         }
+      }
+   }
+   indexInsert(index.data(), capacity, slot);
+}
+
+}
+
+#endif
\ No newline at end of file
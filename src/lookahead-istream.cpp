@@ -5,34 +5,22 @@ using namespace std;
 namespace ccm::toml {
 
 LookaheadIStream::LookaheadIStream(istream &in)
-   : in(in)
+   : in(&in)
 {
 }
 
-int LookaheadIStream::get() {
-   if (buffer.empty()) {
-      return in.get();
+size_t LookaheadIStream::read(char *out, size_t size) {
+   streambuf *sb = in->rdbuf();
+   if (!sb || !in->good()) {
+      return 0;
    }
 
-   int res = buffer[0];
-   buffer.erase(buffer.begin());
-   return res;
-}
-
-int LookaheadIStream::peek(size_t index) {
-   if (index < buffer.size()) {
-      return buffer[index];
+   streamsize n = sb->sgetn(out, size);
+   if (n <= 0) {
+      in->setstate(ios_base::eofbit);
+      return 0;
    }
-
-   while (index > buffer.size()) {
-      int c = in.get();
-      if (c == char_traits<char>::eof()) {
-         return c;
-      }
-      buffer.push_back(c);
-   }
-
-   return in.peek();
+   return n;
 }
 
 }
\ No newline at end of file
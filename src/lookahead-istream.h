@@ -1,21 +1,29 @@
 #ifndef CCM_TOML_LOOKAHEAD_ISTREAM_H
 #define CCM_TOML_LOOKAHEAD_ISTREAM_H
 
+#include "ring-source.h"
+
+#include <cstddef>
 #include <istream>
-#include <vector>
 
 namespace ccm::toml {
 
-class LookaheadIStream {
+// Wraps an istream with arbitrary (up to `capacity`) character lookahead.
+// Characters are pulled from the underlying streambuf in large blocks into a
+// fixed-size ring buffer (see RingSource).
+class LookaheadIStream : public RingSource<LookaheadIStream> {
 public:
-   LookaheadIStream(std::istream &in);
+   static constexpr const char *name = "LookaheadIStream";
 
-   int get();
-   int peek(size_t index=0);
+   LookaheadIStream(std::istream &in);
 
 private:
-   std::istream &in;
-   std::vector<int> buffer;
+   friend class RingSource<LookaheadIStream>;
+
+   std::size_t read(char *out, std::size_t size);
+
+   // A pointer, so that a Tokenizer can reset() to another stream
+   std::istream *in;
 };
 
 }
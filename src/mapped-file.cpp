@@ -0,0 +1,92 @@
+#include "mapped-file.h"
+
+#include "exception.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+// `error` is the errno the call failed with, saved before anything else
+// could change it.
+[[noreturn]] void throwSystemError(const string &what, const string &path,
+                                   int error)
+{
+   throw Exception(what + " failed for " + path + ": " + strerror(error));
+}
+
+} // namespace
+
+MappedFile::MappedFile(const string &path) {
+   int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      throwSystemError("open()", path, errno);
+   }
+
+   struct stat st;
+   if (::fstat(fd, &st) != 0) {
+      int error = errno;
+      ::close(fd);
+      throwSystemError("fstat()", path, error);
+   }
+
+   size = st.st_size;
+   if (size == 0) {
+      // mmap() refuses empty mappings, and there is nothing to read anyway.
+      ::close(fd);
+      return;
+   }
+
+   // Advice is only a hint, so failures are ignored.
+   ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+   ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+   data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   int error = errno;
+   ::close(fd);
+   if (data == MAP_FAILED) {
+      data = nullptr;
+      size = 0;
+      throwSystemError("mmap()", path, error);
+   }
+
+   ::madvise(data, size, MADV_SEQUENTIAL);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+   : data(other.data),
+     size(other.size)
+{
+   other.data = nullptr;
+   other.size = 0;
+}
+
+MappedFile::~MappedFile() {
+   if (data) {
+      ::munmap(data, size);
+   }
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+   if (this != &other) {
+      if (data) {
+         ::munmap(data, size);
+      }
+      data = other.data;
+      size = other.size;
+      other.data = nullptr;
+      other.size = 0;
+   }
+   return *this;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef CCM_TOML_MAPPED_FILE_H
+#define CCM_TOML_MAPPED_FILE_H
+
+#include "buffer-source.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace ccm::toml {
+
+// A read-only memory mapping of an entire file. The kernel is told that the
+// mapping will be read sequentially so that it reads ahead aggressively and
+// drops pages behind us.
+class MappedFile {
+public:
+   MappedFile(const std::string &path);
+   MappedFile(MappedFile &&other) noexcept;
+   MappedFile(const MappedFile &) = delete;
+   ~MappedFile();
+
+   MappedFile &operator=(MappedFile &&other) noexcept;
+   MappedFile &operator=(const MappedFile &) = delete;
+
+   std::string_view view() const
+      { return std::string_view(static_cast<const char *>(data), size); }
+
+private:
+   void *data = nullptr;
+   std::size_t size = 0;
+};
+
+// An input source that maps a file and reads the mapping directly, without
+// copying it into a stream buffer. Use it as Tokenizer<N, MappedFileSource>
+// and pass the path to the Tokenizer's constructor.
+class MappedFileSource : private MappedFile, public BufferSource {
+public:
+   MappedFileSource(const std::string &path)
+      : MappedFile(path),
+        BufferSource(MappedFile::view())
+      { }
+
+   using BufferSource::size;
+};
+
+}
+
+#endif
\ No newline at end of file
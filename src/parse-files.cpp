@@ -0,0 +1,262 @@
+#include "toml.h"
+
+#include "buffer-source.h"
+#include "document-builder.h"
+#include "exception.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+// `error` is the errno the call failed with, saved before anything else
+// could change it.
+[[noreturn]] void throwSystemError(const string &what, const string &path,
+                                   int error)
+{
+   throw Exception(what + " failed for " + path + ": " + strerror(error));
+}
+
+// Returns the size of the file at `path`, or 0 if it can't be found, in which
+// case opening it will fail later and say why.
+size_t fileSize(const string &path) {
+   struct stat st;
+   return ::stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// The files still to parse, dealt out among the threads largest first. Each
+// thread takes files from the front of its own queue and, once that is
+// empty, steals them from the back of the others', so the small files at the
+// backs even out the large ones at the fronts. Nothing is added once work
+// starts, so a queue is a fixed list of files with its front and back in one
+// word, which taking and stealing each move with a compare-and-swap.
+class WorkQueues {
+public:
+   WorkQueues(const vector<size_t> &order, size_t threads)
+      : count(threads),
+        queues(new Queue[threads])
+   {
+      for (size_t i = 0; i < order.size(); ++i) {
+         queues[i % threads].files.push_back(order[i]);
+      }
+      for (size_t t = 0; t < threads; ++t) {
+         queues[t].ends = queues[t].files.size();
+      }
+   }
+
+   // Sets `file` to the next file for thread `self` to parse. Returns false
+   // once there are none left.
+   bool next(size_t self, size_t &file) {
+      if (take(queues[self], file)) {
+         return true;
+      }
+      for (size_t i = 1; i < count; ++i) {
+         if (steal(queues[(self + i) % count], file)) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+private:
+   struct alignas(64) Queue {
+      vector<size_t> files;
+      // The front in the high 32 bits and the back in the low 32
+      atomic<uint64_t> ends{ 0 };
+   };
+
+   static bool take(Queue &queue, size_t &file) {
+      uint64_t ends = queue.ends.load(memory_order_relaxed);
+      while ((ends >> 32) != (ends & 0xFFFFFFFF)) {
+         if (queue.ends.compare_exchange_weak(ends, ends + (uint64_t(1) << 32),
+                                              memory_order_relaxed))
+         {
+            file = queue.files[ends >> 32];
+            return true;
+         }
+      }
+      return false;
+   }
+
+   static bool steal(Queue &queue, size_t &file) {
+      uint64_t ends = queue.ends.load(memory_order_relaxed);
+      while ((ends >> 32) != (ends & 0xFFFFFFFF)) {
+         if (queue.ends.compare_exchange_weak(ends, ends - 1,
+                                              memory_order_relaxed))
+         {
+            file = queue.files[(ends & 0xFFFFFFFF) - 1];
+            return true;
+         }
+      }
+      return false;
+   }
+
+   size_t count;
+   unique_ptr<Queue[]> queues;
+};
+
+// What each thread keeps from one file to the next, so that after the first
+// few files, parsing one allocates little more than its Document.
+class Loader {
+public:
+   explicit Loader(const ParseOptions &options)
+      : options(options),
+        tokenizer(string_view())
+      { }
+
+   void load(LoadedFile &file) {
+      try {
+         read(file.path);
+         tokenizer.reset(string_view(buffer));
+         DocumentBuilder builder(options.upstream, options.strings, &scratch);
+         Parser<Tokenizer<0, BufferSource>, DocumentBuilder>(tokenizer,
+                                                             builder).parse();
+         file.document.emplace(builder.finish());
+      }
+      catch (const SyntaxError &ex) {
+         file.error = ex.what();
+         file.line = ex.line;
+         file.col = ex.col;
+      }
+      catch (const Exception &ex) {
+         file.error = ex.what();
+      }
+      catch (const exception &ex) {
+         file.error = ex.what();
+      }
+   }
+
+private:
+   // Reads the whole file into the buffer, which only grows.
+   void read(const string &path) {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+         throwSystemError("open()", path, errno);
+      }
+
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+         int error = errno;
+         ::close(fd);
+         throwSystemError("fstat()", path, error);
+      }
+
+      // One byte more than the file's size, so that the read that finds the
+      // end needs no room of its own.
+      buffer.resize(st.st_size + 1);
+      size_t size = 0;
+      while (true) {
+         if (size == buffer.size()) {
+            buffer.resize(2 * size);
+         }
+         ssize_t n = ::read(fd, buffer.data() + size, buffer.size() - size);
+         if (n < 0) {
+            if (errno == EINTR) {
+               continue;
+            }
+            int error = errno;
+            ::close(fd);
+            throwSystemError("read()", path, error);
+         }
+         if (n == 0) {
+            break;
+         }
+         size += n;
+      }
+      ::close(fd);
+      buffer.resize(size);
+   }
+
+   const ParseOptions &options;
+   string buffer;
+   Tokenizer<0, BufferSource> tokenizer;
+   pmr::unsynchronized_pool_resource scratch;
+};
+
+}
+
+vector<LoadedFile> parseFiles(const vector<string> &paths,
+                              const ParseOptions &options)
+{
+   vector<LoadedFile> files(paths.size());
+   vector<size_t> sizes(paths.size());
+   vector<size_t> order(paths.size());
+   for (size_t i = 0; i < paths.size(); ++i) {
+      files[i].path = paths[i];
+      sizes[i] = fileSize(paths[i]);
+      order[i] = i;
+   }
+   stable_sort(order.begin(), order.end(),
+               [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+   size_t threads = options.threads;
+   if (threads == 0) {
+      threads = max(thread::hardware_concurrency(), 1u);
+   }
+   threads = max<size_t>(min(threads, paths.size()), 1);
+
+   WorkQueues queues(order, threads);
+   auto work = [&](size_t self) {
+      Loader loader(options);
+      size_t file;
+      while (queues.next(self, file)) {
+         loader.load(files[file]);
+      }
+   };
+
+   vector<thread> workers;
+   for (size_t t = 1; t < threads; ++t) {
+      try {
+         workers.emplace_back(work, t);
+      }
+      catch (const system_error &) {
+         // The threads that did start steal this one's files.
+         break;
+      }
+   }
+   work(0);
+   for (thread &worker : workers) {
+      worker.join();
+   }
+   return files;
+}
+
+vector<LoadedFile> parseGlob(const string &pattern,
+                             const ParseOptions &options)
+{
+   glob_t matches;
+   int result = ::glob(pattern.c_str(), 0, nullptr, &matches);
+   if (result == GLOB_NOMATCH) {
+      ::globfree(&matches);
+      return {};
+   }
+   if (result != 0) {
+      ::globfree(&matches);
+      throw Exception("glob() failed for " + pattern);
+   }
+
+   vector<string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+   ::globfree(&matches);
+   return parseFiles(paths, options);
+}
+
+}
@@ -0,0 +1,117 @@
+#ifndef CCM_TOML_PARSER_H
+#define CCM_TOML_PARSER_H
+
+#include "dotted-key.h"
+#include "reader.h"
+
+namespace ccm::toml {
+
+// Reads a document with a Reader and reports its events to a Handler, which
+// is called with:
+//
+//    onTableHeader(const DottedKey &key)        [a.b]
+//    onArrayTableHeader(const DottedKey &key)   [[a.b]]
+//    onKey(const DottedKey &key)                a.b = ..., before the value
+//    onValue(std::string_view)                  and likewise std::int64_t,
+//                                               double, bool, DateTime,
+//                                               Date and Time
+//    onArrayBegin(), onArrayEnd()               [ ... ] values
+//    onInlineTableBegin(), onInlineTableEnd()   { ... } values
+//
+// Nothing is kept between events, so documents of any size can be processed
+// in constant memory. Keys and strings passed to the handler are only valid
+// during the call. The handler may throw to stop parsing. As with Reader,
+// keys and tables defined twice are left to the handler to detect.
+template<typename Tokenizer, typename Handler>
+class Parser {
+public:
+   Parser(Tokenizer &tokenizer, Handler &handler)
+      : reader(tokenizer),
+        handler(handler)
+      { }
+
+   void parse();
+
+   // Parses some of a large array's elements on their own, reporting them
+   // as values (see Reader::enterArray()).
+   void parseElements() {
+      reader.enterArray();
+      parse();
+   }
+
+private:
+   using Event = typename Reader<Tokenizer>::Event;
+
+   void reportValue();
+
+   Reader<Tokenizer> reader;
+   Handler &handler;
+};
+
+template<typename Tokenizer, typename Handler>
+void Parser<Tokenizer, Handler>::parse() {
+   while (true) {
+      switch (reader.next()) {
+      case Event::End:
+         return;
+      case Event::TableHeader:
+         handler.onTableHeader(reader.key());
+         break;
+      case Event::ArrayTableHeader:
+         handler.onArrayTableHeader(reader.key());
+         break;
+      case Event::Key:
+         handler.onKey(reader.key());
+         break;
+      case Event::Value:
+         reportValue();
+         break;
+      case Event::ArrayBegin:
+         handler.onArrayBegin();
+         break;
+      case Event::ArrayEnd:
+         handler.onArrayEnd();
+         break;
+      case Event::InlineTableBegin:
+         handler.onInlineTableBegin();
+         break;
+      case Event::InlineTableEnd:
+         handler.onInlineTableEnd();
+         break;
+      }
+   }
+}
+
+template<typename Tokenizer, typename Handler>
+void Parser<Tokenizer, Handler>::reportValue() {
+   switch (reader.type()) {
+   case Type::String:
+      handler.onValue(reader.asString());
+      break;
+   case Type::Integer:
+      handler.onValue(reader.asInteger());
+      break;
+   case Type::Float:
+      handler.onValue(reader.asFloat());
+      break;
+   case Type::Boolean:
+      handler.onValue(reader.asBoolean());
+      break;
+   case Type::OffsetDateTime:
+   case Type::LocalDateTime:
+      handler.onValue(reader.asDateTime());
+      break;
+   case Type::LocalDate:
+      handler.onValue(reader.asDate());
+      break;
+   case Type::LocalTime:
+      handler.onValue(reader.asTime());
+      break;
+   default:
+      break;
+   }
+}
+
+}
+
+#endif
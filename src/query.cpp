@@ -0,0 +1,162 @@
+#include "query.h"
+
+#include "exception.h"
+#include "key-index.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+bool isBare(char c) {
+   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+          || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+void skipWhitespace(string_view path, size_t &i) {
+   while (i < path.size() && (path[i] == ' ' || path[i] == '\t')) {
+      ++i;
+   }
+}
+
+// Returns the character that \c stands for in a basic string, or 0 if \c
+// isn't an escape sequence.
+char unescape(char c) {
+   switch (c) {
+   case 'b':
+      return '\b';
+   case 't':
+      return '\t';
+   case 'n':
+      return '\n';
+   case 'f':
+      return '\f';
+   case 'r':
+      return '\r';
+   case '"':
+   case '\\':
+      return c;
+   default:
+      return 0;
+   }
+}
+
+[[noreturn]] void fail(const string &error, size_t i) {
+   throw SyntaxError(error, 1, static_cast<int>(i) + 1);
+}
+
+}
+
+Query::Query(string_view path) {
+   size_t i = 0;
+   while (true) {
+      skipWhitespace(path, i);
+      parseKey(path, i);
+      while (i < path.size() && path[i] == '[') {
+         parseIndex(path, i);
+      }
+      skipWhitespace(path, i);
+      if (i == path.size()) {
+         break;
+      }
+      if (path[i] != '.') {
+         fail("Expected '.' or '['", i);
+      }
+      ++i;
+   }
+}
+
+Value Query::find(const Document &doc) const {
+   Value found;
+   auto first = [&](Value value) { found = value; return false; };
+   visit(doc.root(), 0, first);
+   return found;
+}
+
+Value Query::find(Value from) const {
+   Value found;
+   auto first = [&](Value value) { found = value; return false; };
+   visit(from, 0, first);
+   return found;
+}
+
+// Parses a bare, quoted or wildcard key segment into a step.
+void Query::parseKey(string_view path, size_t &i) {
+   if (i == path.size()) {
+      fail("Expected a key", i);
+   }
+
+   if (path[i] == '*') {
+      steps.push_back(Step{ Step::Kind::Members, 0, 0, 0 });
+      ++i;
+      return;
+   }
+
+   size_t start = names.size();
+   char quote = path[i];
+   if (quote == '"' || quote == '\'') {
+      size_t open = i++;
+      while (i < path.size() && path[i] != quote) {
+         char c = path[i++];
+         if (c == '\\' && quote == '"') {
+            if (i == path.size()) {
+               break;
+            }
+            c = unescape(path[i++]);
+            if (c == 0) {
+               fail("Invalid escape sequence", i - 2);
+            }
+         }
+         names += c;
+      }
+      if (i == path.size()) {
+         fail("Unterminated quoted key", open);
+      }
+      ++i;
+   }
+   else {
+      while (i < path.size() && isBare(path[i])) {
+         names += path[i++];
+      }
+      if (names.size() == start) {
+         fail("Expected a key", i);
+      }
+   }
+
+   size_t length = names.size() - start;
+   uint32_t hash = detail::hashKey(string_view(names).substr(start, length));
+   steps.push_back(Step{ Step::Kind::Key, hash, start, length });
+}
+
+// Parses [n] or [*] into a step.
+void Query::parseIndex(string_view path, size_t &i) {
+   ++i;
+   if (i < path.size() && path[i] == '*') {
+      steps.push_back(Step{ Step::Kind::Elements, 0, 0, 0 });
+      ++i;
+   }
+   else {
+      size_t start = i;
+      size_t index = 0;
+      while (i < path.size() && path[i] >= '0' && path[i] <= '9') {
+         index = index * 10 + (path[i++] - '0');
+         if (index > numeric_limits<uint32_t>::max()) {
+            fail("Index out of range", start);
+         }
+      }
+      if (i == start) {
+         fail("Expected an index or '*'", i);
+      }
+      steps.push_back(Step{ Step::Kind::Index, 0, index, 0 });
+   }
+
+   if (i == path.size() || path[i] != ']') {
+      fail("Expected ']'", i);
+   }
+   ++i;
+}
+
+}
@@ -0,0 +1,144 @@
+#ifndef CCM_TOML_QUERY_H
+#define CCM_TOML_QUERY_H
+
+#include "document.h"
+#include "dotted-key.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+// A path to values in a document, compiled once and then looked up in any
+// number of documents. A path is a dotted key, as in TOML, where any segment
+// may be followed by array indexes, and `*` stands for every member of a
+// table or every element of an array:
+//
+//    database.ports[0]
+//    "quoted.key".limits.max
+//    servers.*.ports[2]
+//    products[*].name
+//
+// Compiling splits the path into steps and hashes its keys, so lookups do no
+// parsing, hashing or allocation. A Query is immutable, so one can be shared
+// between threads.
+class Query {
+public:
+   // Throws SyntaxError (on line 1) if the path is malformed.
+   explicit Query(std::string_view path);
+
+   // Returns the first value the path leads to, or an empty Value if there is
+   // none.
+   Value find(const Document &doc) const;
+   Value find(Value from) const;
+
+   // Calls f(Value) for each value the path leads to, in document order.
+   template<typename F>
+   void forEach(const Document &doc, F &&f) const;
+   template<typename F>
+   void forEach(Value from, F &&f) const;
+
+private:
+   struct Step {
+      enum class Kind : std::uint8_t {
+         Key,
+         Index,
+         Members,
+         Elements
+      };
+
+      Kind kind;
+      std::uint32_t hash;
+      // For a Key, where its name is in `names`; for an Index, the index
+      std::size_t offset;
+      std::size_t length;
+   };
+
+   void parseKey(std::string_view path, std::size_t &i);
+   void parseIndex(std::string_view path, std::size_t &i);
+
+   KeySegment key(const Step &step) const {
+      return KeySegment{ std::string_view(names).substr(step.offset,
+                                                        step.length),
+                         step.hash };
+   }
+
+   template<typename F>
+   bool visit(Table table, std::size_t i, F &f) const;
+   template<typename F>
+   bool visit(Value value, std::size_t i, F &f) const;
+
+   std::vector<Step> steps;
+   std::string names;
+};
+
+// The visit() functions apply steps[i] onwards and call f(Value) for each
+// value they lead to. f returns false to stop, and then so do they.
+template<typename F>
+bool Query::visit(Table table, std::size_t i, F &f) const {
+   const Step &step = steps[i];
+   switch (step.kind) {
+   case Step::Kind::Key:
+      {
+         Value value = table[key(step)];
+         return !value || visit(value, i + 1, f);
+      }
+   case Step::Kind::Members:
+      for (Table::Entry entry : table) {
+         if (!visit(entry.value, i + 1, f)) {
+            return false;
+         }
+      }
+      return true;
+   default:
+      return true;
+   }
+}
+
+template<typename F>
+bool Query::visit(Value value, std::size_t i, F &f) const {
+   if (i == steps.size()) {
+      return f(value);
+   }
+
+   const Step &step = steps[i];
+   switch (step.kind) {
+   case Step::Kind::Key:
+   case Step::Kind::Members:
+      return !value.is(Type::Table) || visit(value.asTable(), i, f);
+   case Step::Kind::Index:
+      {
+         Value element = value[step.offset];
+         return !element || visit(element, i + 1, f);
+      }
+   case Step::Kind::Elements:
+      if (value.is(Type::Array)) {
+         for (Value element : value.asArray()) {
+            if (!visit(element, i + 1, f)) {
+               return false;
+            }
+         }
+      }
+      return true;
+   }
+   return true;
+}
+
+template<typename F>
+void Query::forEach(const Document &doc, F &&f) const {
+   auto each = [&](Value value) { f(value); return true; };
+   visit(doc.root(), 0, each);
+}
+
+template<typename F>
+void Query::forEach(Value from, F &&f) const {
+   auto each = [&](Value value) { f(value); return true; };
+   visit(from, 0, each);
+}
+
+}
+
+#endif
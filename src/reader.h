@@ -0,0 +1,712 @@
+#ifndef CCM_TOML_READER_H
+#define CCM_TOML_READER_H
+
+#include "cell.h"
+#include "date-time.h"
+#include "decode.h"
+#include "dotted-key.h"
+#include "exception.h"
+#include "key-index.h"
+#include "token.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace ccm::toml {
+
+// Reads a document from the tokens of a Tokenizer one event at a time, as
+// the caller asks for them, enforcing the parts of the TOML grammar that the
+// Tokenizer doesn't: what may follow what, and the ranges of date and time
+// fields. The rules about defining keys and tables only once need the whole
+// document, so they are left to the caller; DocumentBuilder enforces them.
+//
+// next() returns one of
+//
+//    TableHeader, ArrayTableHeader   [a.b] or [[a.b]]; see key()
+//    Key                             a.b = ..., before the value; see key()
+//    Value                           a string, number, boolean, date or time;
+//                                    see type() and the as...() functions
+//    ArrayBegin, ArrayEnd            [ ... ] values
+//    InlineTableBegin, InlineTableEnd  { ... } values
+//    End                             the end of the document
+//
+// so `a = [1, {b = 2}]` is Key, ArrayBegin, Value, InlineTableBegin, Key,
+// Value, InlineTableEnd, ArrayEnd. Keys and values are valid until the next
+// call to next() or skip().
+//
+// skip() passes over whatever the last event began without decoding it: the
+// value of a Key, the rest of an array or inline table, or the key/value
+// pairs of a table section up to the next header. The Tokenizer skims
+// through it (see Tokenizer::skim()), so no strings, numbers or dates are
+// decoded, and skipped parts are only checked as far as the Tokenizer checks
+// them. Skimming only works on tokens that haven't been read yet, so the
+// Tokenizer must not read ahead: NLookahead must be 0.
+//
+// If the Tokenizer is lazy (see Tokenizer::lazy()), values are only decoded
+// when one of the as...() functions asks for them, once per value. A number
+// that is out of range is then reported by that call rather than by next().
+//
+//    Tokenizer<0, MappedFileSource> tokenizer(path);
+//    Reader reader(tokenizer);
+template<typename Tokenizer>
+class Reader {
+   static_assert(Tokenizer::lookaheadTokens == 0,
+                 "Reader needs a Tokenizer that doesn't read ahead");
+
+public:
+   enum class Event {
+      End,
+      TableHeader,
+      ArrayTableHeader,
+      Key,
+      Value,
+      ArrayBegin,
+      ArrayEnd,
+      InlineTableBegin,
+      InlineTableEnd
+   };
+
+   explicit Reader(Tokenizer &tokenizer)
+      : tokenizer(tokenizer)
+      { }
+
+   Event next();
+   void skip();
+
+   // Reads some of a large array's elements on their own, split from the
+   // rest at commas between them, after the Tokenizer has been moved to them
+   // with Tokenizer::enterArray() and seek(). next() returns their events
+   // and then End at the end of the input, which must come just after a
+   // comma between elements or where the array's ']' would be.
+   void enterArray() {
+      frames.push_back(Frame{ Context::Array, false, true });
+      slice = true;
+   }
+
+   // The key of the last TableHeader, ArrayTableHeader or Key event
+   const DottedKey &key() const
+      { return currentKey; }
+
+   // The last Value event's value. These throw Exception if the last event
+   // wasn't a Value or the value has a different type.
+   Type type() const
+      { return typeOf(expectValue().kind); }
+   std::string_view asString() const
+      { return std::get<std::string_view>(valueOf(Type::String)); }
+   std::int64_t asInteger() const
+      { return std::get<std::int64_t>(valueOf(Type::Integer)); }
+   double asFloat() const
+      { return std::get<double>(valueOf(Type::Float)); }
+   bool asBoolean() const
+      { return std::get<bool>(expect(Type::Boolean).value); }
+   // Offset or local date-time
+   DateTime asDateTime() const;
+   Date asDate() const
+      { return std::get<Date>(expect(Type::LocalDate).value); }
+   Time asTime() const
+      { return std::get<Time>(expect(Type::LocalTime).value); }
+
+private:
+   enum class Context : std::uint8_t {
+      Document,
+      Array,
+      InlineTable
+   };
+
+   // An open container. `afterValue` is set once one of its values is done,
+   // so that a separator (a newline, for the document) must come next.
+   struct Frame {
+      Context context;
+      bool afterValue;
+      bool empty;
+   };
+
+   void advance();
+   bool atChar(char c) const;
+   bool atEndOfSlice() const
+      { return slice && !token && frames.size() == 2; }
+   void skipWhitespace();
+   void skipBlankLines();
+   void expectEndOfLine();
+   void parseKey();
+   Event readHeader(Event header);
+   Event readKey();
+   Event readValue();
+   Event close(Event end);
+   void skipValue();
+   void skipNested();
+   void skipSection();
+   const Token &expectValue() const;
+   const Token &expect(Type expected) const;
+   const Token::Value &valueOf(Type expected) const;
+   static Type typeOf(Token::Kind kind);
+   void checkDate(const Date &date) const;
+   void checkTime(const Time &time) const;
+   [[noreturn]] void fail(const std::string &error) const;
+   void endPosition(int &line, int &col) const;
+
+   Tokenizer &tokenizer;
+
+   // The current token, or null at the end of the input. It remains valid
+   // until the next call to advance().
+   const Token *token = nullptr;
+
+   // At the end of the input, the last token, if any. The Tokenizer leaves it
+   // alone once it runs out of tokens.
+   const Token *last = nullptr;
+
+   // Set when the last event used the current token, which is then only
+   // advanced past when the next event is asked for. Reading no further than
+   // the caller asks lets skip() skim everything it skips.
+   bool pending = true;
+
+   // The last event, and the token of the last Value, if it is one
+   Event event = Event::End;
+   const Token *value = nullptr;
+
+   // The last Value's decoded value, if it was deferred and has been asked
+   // for. decodedChars holds a decoded string's characters.
+   mutable std::optional<Token::Value> decoded;
+   mutable std::string decodedChars;
+
+   std::vector<Frame> frames = { Frame{ Context::Document, false, true } };
+
+   // Set by enterArray(), when frames[1] is the array being read from
+   bool slice = false;
+
+   // The key parsed last. Token values don't outlive the token, so the names
+   // are copied into keyChars; `ends` holds where each one ends.
+   std::string keyChars;
+   std::vector<std::size_t> ends;
+   std::vector<KeySegment> segments;
+   DottedKey currentKey{ nullptr, 0, 0, 0 };
+};
+
+template<typename Tokenizer>
+typename Reader<Tokenizer>::Event Reader<Tokenizer>::next() {
+   if (pending) {
+      advance();
+      pending = false;
+   }
+   value = nullptr;
+   decoded.reset();
+
+   if (event == Event::Key) {
+      skipWhitespace();
+      return readValue();
+   }
+
+   Frame &frame = frames.back();
+   switch (frame.context) {
+   case Context::Document:
+      if (frame.afterValue) {
+         expectEndOfLine();
+         frame.afterValue = false;
+      }
+      skipBlankLines();
+      if (!token) {
+         return event = Event::End;
+      }
+      if (token->kind == Token::Kind::ArrayTableOpen) {
+         return readHeader(Event::ArrayTableHeader);
+      }
+      if (atChar('[')) {
+         return readHeader(Event::TableHeader);
+      }
+      if (token->kind == Token::Kind::Id
+          || token->kind == Token::Kind::String)
+      {
+         return readKey();
+      }
+      fail("Expected a key or table header");
+   case Context::Array:
+      skipBlankLines();
+      if (frame.afterValue) {
+         if (atChar(',')) {
+            advance();
+            skipBlankLines();
+         }
+         else if (!atChar(']') && !atEndOfSlice()) {
+            fail("Expected ',' or ']'");
+         }
+         frame.afterValue = false;
+      }
+      if (atEndOfSlice()) {
+         return event = Event::End;
+      }
+      if (atChar(']')) {
+         if (slice && frames.size() == 2) {
+            fail("Unexpected ']'");
+         }
+         return close(Event::ArrayEnd);
+      }
+      return readValue();
+   case Context::InlineTable:
+      if (frame.afterValue) {
+         skipWhitespace();
+         if (atChar('}')) {
+            return close(Event::InlineTableEnd);
+         }
+         if (!atChar(',')) {
+            fail("Expected ',' or '}'");
+         }
+         advance();
+         frame.afterValue = false;
+      }
+      else if (frame.empty) {
+         skipWhitespace();
+         if (atChar('}')) {
+            return close(Event::InlineTableEnd);
+         }
+      }
+      frame.empty = false;
+      return readKey();
+   }
+   fail("Unexpected state");
+}
+
+template<typename Tokenizer>
+void Reader<Tokenizer>::skip() {
+   value = nullptr;
+   decoded.reset();
+   tokenizer.skim(true);
+
+   switch (event) {
+   case Event::Key:
+      advance();
+      skipWhitespace();
+      skipValue();
+      // Carry on as if the value had been read.
+      event = Event::Value;
+      break;
+   case Event::ArrayBegin:
+   case Event::InlineTableBegin:
+      frames.pop_back();
+      skipNested();
+      event = Event::Value;
+      break;
+   case Event::TableHeader:
+   case Event::ArrayTableHeader:
+      advance();
+      expectEndOfLine();
+      frames.back().afterValue = false;
+      skipSection();
+      break;
+   default:
+      // There is nothing to skip.
+      tokenizer.skim(false);
+      return;
+   }
+
+   tokenizer.skim(false);
+   pending = false;
+}
+
+template<typename Tokenizer>
+DateTime Reader<Tokenizer>::asDateTime() const {
+   const Token &t = expectValue();
+   if (t.kind == Token::Kind::OffsetDateTime) {
+      return std::get<DateTime>(t.value);
+   }
+   return std::get<DateTime>(expect(Type::LocalDateTime).value);
+}
+
+template<typename Tokenizer>
+void Reader<Tokenizer>::advance() {
+   if (tokenizer.more()) {
+      token = &tokenizer.next();
+   }
+   else if (token) {
+      last = token;
+      token = nullptr;
+   }
+}
+
+template<typename Tokenizer>
+bool Reader<Tokenizer>::atChar(char c) const {
+   return token && token->kind == Token::Kind::Char && token->lexeme[0] == c;
+}
+
+// Skips whitespace and comments, stopping at the end of the line.
+template<typename Tokenizer>
+void Reader<Tokenizer>::skipWhitespace() {
+   while (token && (token->kind == Token::Kind::Whitespace
+                    || token->kind == Token::Kind::Comment))
+   {
+      advance();
+   }
+}
+
+// Skips whitespace, comments and newlines, as allowed inside arrays.
+template<typename Tokenizer>
+void Reader<Tokenizer>::skipBlankLines() {
+   while (token && (token->kind == Token::Kind::Whitespace
+                    || token->kind == Token::Kind::Comment
+                    || token->kind == Token::Kind::Newline))
+   {
+      advance();
+   }
+}
+
+template<typename Tokenizer>
+void Reader<Tokenizer>::expectEndOfLine() {
+   skipWhitespace();
+   if (!token) {
+      return;
+   }
+   if (token->kind != Token::Kind::Newline) {
+      fail("Expected a newline");
+   }
+   advance();
+}
+
+// Parses a simple or dotted key into currentKey. Stops at the first token
+// after the key that isn't whitespace.
+template<typename Tokenizer>
+void Reader<Tokenizer>::parseKey() {
+   int line, col;
+   if (token) {
+      line = token->line;
+      col = token->col;
+   }
+   else {
+      endPosition(line, col);
+   }
+
+   keyChars.clear();
+   ends.clear();
+   while (true) {
+      skipWhitespace();
+      if (!token) {
+         fail("Expected a key");
+      }
+      if (token->kind == Token::Kind::String) {
+         std::string_view lexeme = token->lexeme;
+         if (lexeme.substr(0, 3) == "\"\"\"" || lexeme.substr(0, 3) == "'''") {
+            fail("Multi-line strings cannot be keys");
+         }
+      }
+      else if (token->kind != Token::Kind::Id) {
+         fail("Expected a key");
+      }
+      keyChars += std::get<std::string_view>(token->value);
+      ends.push_back(keyChars.size());
+      advance();
+
+      skipWhitespace();
+      if (!atChar('.')) {
+         break;
+      }
+      advance();
+   }
+
+   // keyChars is complete, so it won't move any more.
+   segments.clear();
+   std::size_t start = 0;
+   for (std::size_t end : ends) {
+      std::string_view name(keyChars.data() + start, end - start);
+      segments.push_back(KeySegment{ name, detail::hashKey(name) });
+      start = end;
+   }
+   currentKey = DottedKey{ segments.data(), segments.size(), line, col };
+}
+
+// Reads a [table] or [[array]] header, leaving the check for the newline
+// after it for the next event.
+template<typename Tokenizer>
+typename Reader<Tokenizer>::Event Reader<Tokenizer>::readHeader(Event header)
+{
+   advance();
+   parseKey();
+   if (header == Event::TableHeader) {
+      if (!atChar(']')) {
+         fail("Expected ']'");
+      }
+   }
+   else if (!token || token->kind != Token::Kind::ArrayTableClose) {
+      fail("Expected ']]'");
+   }
+
+   pending = true;
+   frames.back().afterValue = true;
+   return event = header;
+}
+
+template<typename Tokenizer>
+typename Reader<Tokenizer>::Event Reader<Tokenizer>::readKey() {
+   parseKey();
+   if (!atChar('=')) {
+      fail("Expected '='");
+   }
+   pending = true;
+   return event = Event::Key;
+}
+
+template<typename Tokenizer>
+typename Reader<Tokenizer>::Event Reader<Tokenizer>::readValue() {
+   if (!token) {
+      fail("Expected a value");
+   }
+
+   switch (token->kind) {
+   case Token::Kind::Integer:
+   case Token::Kind::Float:
+   case Token::Kind::Boolean:
+   case Token::Kind::String:
+      break;
+   case Token::Kind::OffsetDateTime:
+   case Token::Kind::LocalDateTime:
+      {
+         const DateTime &dateTime = std::get<DateTime>(token->value);
+         checkDate(dateTime.date);
+         checkTime(dateTime.time);
+         if (dateTime.offset
+             && (dateTime.offset->hours > 23 || dateTime.offset->minutes > 59))
+         {
+            fail("Invalid time zone offset");
+         }
+         break;
+      }
+   case Token::Kind::LocalDate:
+      checkDate(std::get<Date>(token->value));
+      break;
+   case Token::Kind::LocalTime:
+      checkTime(std::get<Time>(token->value));
+      break;
+   case Token::Kind::Char:
+      if (atChar('[')) {
+         frames.back().afterValue = true;
+         frames.push_back(Frame{ Context::Array, false, true });
+         pending = true;
+         return event = Event::ArrayBegin;
+      }
+      if (atChar('{')) {
+         frames.back().afterValue = true;
+         frames.push_back(Frame{ Context::InlineTable, false, true });
+         pending = true;
+         return event = Event::InlineTableBegin;
+      }
+      fail("Expected a value");
+   default:
+      fail("Expected a value");
+   }
+
+   frames.back().afterValue = true;
+   value = token;
+   pending = true;
+   return event = Event::Value;
+}
+
+template<typename Tokenizer>
+typename Reader<Tokenizer>::Event Reader<Tokenizer>::close(Event end) {
+   frames.pop_back();
+   pending = true;
+   return event = end;
+}
+
+// Skips the value at the current token and advances past it.
+template<typename Tokenizer>
+void Reader<Tokenizer>::skipValue() {
+   if (!token) {
+      fail("Expected a value");
+   }
+   frames.back().afterValue = true;
+   if (atChar('[') || atChar('{')) {
+      skipNested();
+      return;
+   }
+   switch (token->kind) {
+   case Token::Kind::Integer:
+   case Token::Kind::Float:
+   case Token::Kind::Boolean:
+   case Token::Kind::String:
+   case Token::Kind::OffsetDateTime:
+   case Token::Kind::LocalDateTime:
+   case Token::Kind::LocalDate:
+   case Token::Kind::LocalTime:
+   case Token::Kind::Skimmed:
+      advance();
+      return;
+   default:
+      fail("Expected a value");
+   }
+}
+
+// Skips from the '[' or '{' at the current token to just past the matching
+// ']' or '}'. The Tokenizer has already checked that they match up.
+template<typename Tokenizer>
+void Reader<Tokenizer>::skipNested() {
+   int depth = 0;
+   do {
+      if (!token) {
+         fail("Expected ']' or '}'");
+      }
+      if (token->kind == Token::Kind::Char) {
+         char c = token->lexeme[0];
+         if (c == '[' || c == '{') {
+            ++depth;
+         }
+         else if (c == ']' || c == '}') {
+            --depth;
+         }
+      }
+      advance();
+   } while (depth > 0);
+}
+
+// Skips key/value pairs up to the next header, which starts a line and isn't
+// inside a multi-line array.
+template<typename Tokenizer>
+void Reader<Tokenizer>::skipSection() {
+   bool lineStart = true;
+   int depth = 0;
+   for (; token; advance()) {
+      switch (token->kind) {
+      case Token::Kind::Newline:
+         lineStart = true;
+         break;
+      case Token::Kind::Whitespace:
+      case Token::Kind::Comment:
+         break;
+      case Token::Kind::ArrayTableOpen:
+         if (lineStart && depth == 0) {
+            return;
+         }
+         lineStart = false;
+         break;
+      case Token::Kind::Char:
+         {
+            char c = token->lexeme[0];
+            if (c == '[' && lineStart && depth == 0) {
+               return;
+            }
+            if (c == '[' || c == '{') {
+               ++depth;
+            }
+            else if (c == ']' || c == '}') {
+               --depth;
+            }
+            lineStart = false;
+            break;
+         }
+      default:
+         lineStart = false;
+      }
+   }
+}
+
+template<typename Tokenizer>
+const Token &Reader<Tokenizer>::expectValue() const {
+   if (!value) {
+      throw Exception("Reader: the last event was not a value");
+   }
+   return *value;
+}
+
+template<typename Tokenizer>
+const Token &Reader<Tokenizer>::expect(Type expected) const {
+   const Token &t = expectValue();
+   if (typeOf(t.kind) != expected) {
+      throw Exception(std::string("Expected ") + typeName(expected) + ", got "
+                      + typeName(typeOf(t.kind)));
+   }
+   return t;
+}
+
+// Returns the last Value's value, decoding it first if it was deferred.
+template<typename Tokenizer>
+const Token::Value &Reader<Tokenizer>::valueOf(Type expected) const {
+   const Token &t = expect(expected);
+   if (!t.deferred) {
+      return t.value;
+   }
+   if (!decoded) {
+      decoded = decodeValue(t, decodedChars);
+   }
+   return *decoded;
+}
+
+template<typename Tokenizer>
+Type Reader<Tokenizer>::typeOf(Token::Kind kind) {
+   switch (kind) {
+   case Token::Kind::Integer:
+      return Type::Integer;
+   case Token::Kind::Float:
+      return Type::Float;
+   case Token::Kind::Boolean:
+      return Type::Boolean;
+   case Token::Kind::OffsetDateTime:
+      return Type::OffsetDateTime;
+   case Token::Kind::LocalDateTime:
+      return Type::LocalDateTime;
+   case Token::Kind::LocalDate:
+      return Type::LocalDate;
+   case Token::Kind::LocalTime:
+      return Type::LocalTime;
+   default:
+      return Type::String;
+   }
+}
+
+template<typename Tokenizer>
+void Reader<Tokenizer>::checkDate(const Date &date) const {
+   static constexpr int daysInMonth[] = {
+      31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+   };
+
+   if (date.month < 1 || date.month > 12 || date.day < 1) {
+      fail("Invalid date");
+   }
+   bool leapYear = date.year % 4 == 0
+                   && (date.year % 100 != 0 || date.year % 400 == 0);
+   int days = daysInMonth[date.month - 1] + (date.month == 2 && leapYear);
+   if (date.day > days) {
+      fail("Invalid date");
+   }
+}
+
+// Seconds go up to 60 for leap seconds.
+template<typename Tokenizer>
+void Reader<Tokenizer>::checkTime(const Time &time) const {
+   if (time.hour > 23 || time.minute > 59 || time.second > 60) {
+      fail("Invalid time");
+   }
+}
+
+template<typename Tokenizer>
+void Reader<Tokenizer>::fail(const std::string &error) const {
+   if (token) {
+      throw SyntaxError(error, token->line, token->col);
+   }
+   int line, col;
+   endPosition(line, col);
+   throw SyntaxError(error + " (unexpected EOF)", line, col);
+}
+
+// Finds where the input ends, which is only needed for errors.
+template<typename Tokenizer>
+void Reader<Tokenizer>::endPosition(int &line, int &col) const {
+   line = 1;
+   col = 1;
+   if (last) {
+      line = last->line;
+      col = last->col;
+      for (char c : last->lexeme) {
+         if (c == '\n') {
+            ++line;
+            col = 1;
+         }
+         else {
+            ++col;
+         }
+      }
+   }
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef CCM_TOML_RING_SOURCE_H
+#define CCM_TOML_RING_SOURCE_H
+
+#include "exception.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace ccm::toml {
+
+// The ring buffer behind the input sources that read a stream in large
+// blocks, giving arbitrary (up to `capacity`) character lookahead. get() and
+// peek() are a couple of index operations in the common case.
+//
+// Source derives from RingSource<Source> and provides
+//
+//    static constexpr const char *name;
+//    std::size_t read(char *out, std::size_t size);
+//
+// where read() reads up to `size` characters into `out` and returns how many
+// it read, 0 meaning EOF. It is not called again once it has returned 0.
+template<typename Source>
+class RingSource {
+public:
+   static constexpr std::size_t capacity = 64 * 1024;
+
+   int get() {
+      if (count == 0 && !fill(0)) {
+         return std::char_traits<char>::eof();
+      }
+      int c = static_cast<unsigned char>(buffer[head]);
+      head = (head + 1) & mask;
+      --count;
+      return c;
+   }
+
+   int peek(std::size_t index=0) {
+      if (index >= count && !fill(index)) {
+         return std::char_traits<char>::eof();
+      }
+      return static_cast<unsigned char>(buffer[(head + index) & mask]);
+   }
+
+protected:
+   RingSource()
+      : buffer(new char[capacity])
+      { }
+
+private:
+   static constexpr std::size_t mask = capacity - 1;
+   static_assert((capacity & mask) == 0, "capacity must be a power of two");
+
+   bool fill(std::size_t index);
+
+   std::unique_ptr<char[]> buffer;
+   std::size_t head = 0;
+   std::size_t count = 0;
+   bool eof = false;
+};
+
+// Reads until the character at `index` (relative to head) is buffered.
+// Returns false if EOF is reached first.
+template<typename Source>
+bool RingSource<Source>::fill(std::size_t index) {
+   if (index >= capacity) {
+      throw Exception(std::string(Source::name) + "::peek(): "
+                      + std::to_string(index)
+                      + " exceeds the lookahead capacity");
+   }
+
+   while (index >= count && !eof) {
+      // The free region of the ring may wrap around the end of the buffer, in
+      // which case it takes two reads to fill it.
+      std::size_t tail = (head + count) & mask;
+      std::size_t chunk = std::min(capacity - count, capacity - tail);
+      std::size_t n = static_cast<Source *>(this)->read(buffer.get() + tail,
+                                                         chunk);
+      if (n == 0) {
+         eof = true;
+      }
+      else {
+         count += n;
+      }
+   }
+
+   return index < count;
+}
+
+}
+
+#endif
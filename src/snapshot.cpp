@@ -0,0 +1,163 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+// Layout numbers are unique across the process, so that a KeyHandle can't
+// mistake one document's cells for another's. 0 means no layout.
+uint32_t newLayout() {
+   static atomic<uint32_t> last{ 0 };
+   uint32_t layout = last.fetch_add(1, memory_order_relaxed) + 1;
+   return layout != 0 ? layout : newLayout();
+}
+
+// True if cell i of both documents has the same type and, for tables and
+// arrays, the same members in the same cells under the same keys.
+bool sameCells(const detail::Storage &a, const detail::Storage &b,
+               uint32_t i)
+{
+   const detail::Cell &x = a.cells[i];
+   const detail::Cell &y = b.cells[i];
+   if (x.type != y.type) {
+      return false;
+   }
+   if (x.type != Type::Table && x.type != Type::Array) {
+      return true;
+   }
+   if (x.range.first != y.range.first || x.range.count != y.range.count) {
+      return false;
+   }
+
+   for (uint32_t j = x.range.first; j < x.range.first + x.range.count; ++j) {
+      if (x.type == Type::Table
+          && a.string(a.keys[j]) != b.string(b.keys[j]))
+      {
+         return false;
+      }
+      if (!sameCells(a, b, j)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+}
+
+Snapshot::Snapshot(Document doc)
+   : Snapshot(std::move(doc), newLayout())
+{
+}
+
+Snapshot::Snapshot(Document doc, uint32_t layoutId)
+   : doc(make_shared<const Document>(std::move(doc))),
+     layoutId(layoutId)
+{
+}
+
+LiveDocument::LiveDocument(Document doc)
+   : current(new Snapshot(std::move(doc))),
+     slots(new Slot[slotCount])
+{
+}
+
+LiveDocument::~LiveDocument() {
+   delete current.load();
+   for (const Snapshot *snapshot : retired) {
+      delete snapshot;
+   }
+}
+
+Snapshot LiveDocument::load() const {
+   // Each thread starts where it last found a free slot, so that threads
+   // seldom compete for one.
+   static thread_local size_t start
+      = hash<thread::id>()(this_thread::get_id()) % slotCount;
+
+   const Snapshot *snapshot = current.load();
+   for (size_t i = start; ; i = (i + 1) % slotCount) {
+      Slot &slot = slots[i];
+      const Snapshot *expected = nullptr;
+      if (!slot.hazard.compare_exchange_strong(expected, snapshot)) {
+         if ((i + 1) % slotCount == start) {
+            this_thread::yield();
+         }
+         continue;
+      }
+
+      // publish() frees a replaced snapshot only if no slot holds it, so once
+      // the snapshot is marked and still current, it is safe to copy.
+      while (true) {
+         const Snapshot *now = current.load();
+         if (now == snapshot) {
+            break;
+         }
+         snapshot = now;
+         slot.hazard.store(snapshot);
+      }
+      Snapshot copy = *snapshot;
+      slot.hazard.store(nullptr, memory_order_release);
+      start = i;
+      return copy;
+   }
+}
+
+void LiveDocument::publish(Document doc) {
+   lock_guard<mutex> lock(publishing);
+
+   const Snapshot *old = current.load(memory_order_relaxed);
+   uint32_t layout = sameLayout(*old->doc, doc) ? old->layoutId : newLayout();
+   current.store(new Snapshot(std::move(doc), layout));
+   retired.push_back(old);
+
+   auto marked = [&](const Snapshot *snapshot) {
+      for (size_t i = 0; i < slotCount; ++i) {
+         if (slots[i].hazard.load() == snapshot) {
+            return true;
+         }
+      }
+      return false;
+   };
+   auto freed = remove_if(retired.begin(), retired.end(),
+                          [&](const Snapshot *snapshot) {
+                             if (marked(snapshot)) {
+                                return false;
+                             }
+                             delete snapshot;
+                             return true;
+                          });
+   retired.erase(freed, retired.end());
+}
+
+bool LiveDocument::sameLayout(const Document &a, const Document &b) {
+   return sameCells(*a.storage, *b.storage, 0);
+}
+
+Value KeyHandle::find(const Snapshot &snapshot) const {
+   if (!snapshot) {
+      return Value();
+   }
+
+   const detail::Storage *storage = snapshot->storage;
+   uint64_t cached = cache.load(memory_order_relaxed);
+   if ((cached >> 32) == snapshot.layout()) {
+      uint32_t index = static_cast<uint32_t>(cached);
+      return index == missing ? Value()
+                              : Value(storage, storage->cells + index);
+   }
+
+   Value value = query.find(snapshot.document());
+   uint32_t index = value ? static_cast<uint32_t>(value.cell - storage->cells)
+                          : missing;
+   cache.store(uint64_t(snapshot.layout()) << 32 | index,
+               memory_order_relaxed);
+   return value;
+}
+
+}
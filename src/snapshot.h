@@ -0,0 +1,140 @@
+#ifndef CCM_TOML_SNAPSHOT_H
+#define CCM_TOML_SNAPSHOT_H
+
+#include "document.h"
+#include "query.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+// A Document shared between threads: copies refer to the same document,
+// which lives until the last copy is gone. Documents are immutable, so any
+// number of threads can read one snapshot at once. Values taken from a
+// snapshot are valid for as long as some copy of it is kept.
+//
+// Each snapshot has a layout, a number that it shares with earlier
+// snapshots published to the same LiveDocument whose tables, arrays and keys
+// sit in the same cells (see KeyHandle). Other snapshots get layouts of
+// their own.
+class Snapshot {
+public:
+   // Refers to no document
+   Snapshot() = default;
+   explicit Snapshot(Document doc);
+
+   explicit operator bool() const
+      { return doc != nullptr; }
+
+   const Document &document() const
+      { return *doc; }
+   const Document *operator->() const
+      { return doc.get(); }
+
+   Table root() const
+      { return doc->root(); }
+   Value operator[](std::string_view key) const
+      { return (*doc)[key]; }
+
+   std::uint32_t layout() const
+      { return layoutId; }
+
+private:
+   friend class LiveDocument;
+
+   Snapshot(Document doc, std::uint32_t layoutId);
+
+   std::shared_ptr<const Document> doc;
+   std::uint32_t layoutId = 0;
+};
+
+// Holds the current snapshot of a document that is reloaded while other
+// threads read it, in the manner of read-copy-update:
+//
+//    LiveDocument config(parseFile(path));
+//
+//    // On request threads
+//    Snapshot snapshot = config.load();
+//    int64_t limit = snapshot["limits"]["max"].asInteger();
+//
+//    // On a reloading thread
+//    config.publish(parseFile(path));
+//
+// load() takes no locks: it marks the snapshot it is about to copy in one of
+// slotCount hazard slots, checks that the snapshot is still current, and
+// copies it, so readers see either the old document or the new one, each
+// whole. publish() swaps in the new snapshot and frees the old one's holder
+// once no load() is copying it; the document itself lives on until readers
+// drop their copies. Publishers are serialized by a mutex that readers never
+// touch.
+class LiveDocument {
+public:
+   // Loads in progress at once beyond this many wait for a slot to free up.
+   static constexpr std::size_t slotCount = 64;
+
+   explicit LiveDocument(Document doc);
+   LiveDocument(const LiveDocument &) = delete;
+   LiveDocument &operator=(const LiveDocument &) = delete;
+
+   // No load() may still be running.
+   ~LiveDocument();
+
+   Snapshot load() const;
+
+   // Makes `doc` the current document. If it has the same layout as the
+   // current one, the snapshot keeps the current snapshot's layout number.
+   void publish(Document doc);
+
+private:
+   struct alignas(64) Slot {
+      std::atomic<const Snapshot *> hazard{ nullptr };
+   };
+
+   static bool sameLayout(const Document &a, const Document &b);
+
+   std::atomic<const Snapshot *> current;
+   std::unique_ptr<Slot[]> slots;
+
+   std::mutex publishing;
+   std::vector<const Snapshot *> retired;
+};
+
+// A path to a value (see Query) that remembers which cell it led to in the
+// last snapshot it was looked up in. Looking it up again in a snapshot with
+// the same layout goes straight to that cell, without hashing or comparing
+// keys; other snapshots are searched as a Query would be, and the result is
+// remembered for next time. A handle can be shared between threads.
+class KeyHandle {
+public:
+   // Throws SyntaxError (on line 1) if the path is malformed.
+   explicit KeyHandle(std::string_view path)
+      : query(path)
+      { }
+
+   KeyHandle(const KeyHandle &other)
+      : query(other.query),
+        cache(other.cache.load(std::memory_order_relaxed))
+      { }
+
+   // Returns the first value the path leads to, or an empty Value.
+   Value find(const Snapshot &snapshot) const;
+
+private:
+   // Stands for "no value" in the cache
+   static constexpr std::uint32_t missing = 0xFFFFFFFF;
+
+   Query query;
+
+   // The layout in the high 32 bits and the cell's index in the low 32
+   mutable std::atomic<std::uint64_t> cache{ 0 };
+};
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "string-pool.h"
+
+#include "exception.h"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace ccm::toml {
+
+StringPool::StringPool(size_t capacity)
+   : capacity(capacity)
+{
+   if (capacity == 0 || capacity > maxCapacity) {
+      throw Exception("StringPool: capacity must be between 1 and "
+                      + to_string(maxCapacity));
+   }
+   void *p = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (p == MAP_FAILED) {
+      throw Exception(string("StringPool: could not reserve memory: ")
+                      + strerror(errno));
+   }
+   base = static_cast<char *>(p);
+}
+
+StringPool::~StringPool() {
+   ::munmap(base, capacity);
+}
+
+size_t StringPool::count() const {
+   lock_guard<std::mutex> lock(mutex);
+   return entries.size();
+}
+
+size_t StringPool::size() const {
+   lock_guard<std::mutex> lock(mutex);
+   return used;
+}
+
+uint32_t StringPool::intern(string_view s, uint32_t hash) {
+   if (!index.empty()) {
+      auto keyAt = [&](uint32_t i) {
+         return string_view(base + entries[i].offset, entries[i].length);
+      };
+      int64_t found = detail::indexFind(index.data(), index.size(), s, hash,
+                                        keyAt);
+      if (found >= 0) {
+         return entries[found].offset;
+      }
+   }
+
+   if (s.size() > capacity - used) {
+      throw Exception("StringPool: the pool is full");
+   }
+   Entry entry{ static_cast<uint32_t>(used), static_cast<uint32_t>(s.size()) };
+   if (!s.empty()) {
+      memcpy(base + used, s.data(), s.size());
+   }
+   used += s.size();
+   entries.push_back(entry);
+   uint32_t count = entries.size();
+   detail::indexAdd(index, count, detail::IndexSlot{ hash, count });
+   return entry.offset;
+}
+
+}
\ No newline at end of file
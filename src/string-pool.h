@@ -0,0 +1,76 @@
+#ifndef CCM_TOML_STRING_POOL_H
+#define CCM_TOML_STRING_POOL_H
+
+#include "key-index.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+// Stores each distinct string once, for sharing keys and short strings
+// between documents: pass one to parse() through ParseOptions, and documents
+// parsed with it keep their interned strings here instead of in their own
+// arenas. Strings are never removed, so a pool suits a bounded vocabulary
+// (a fleet of configs with the same keys) rather than arbitrary data.
+//
+// The pool reserves `capacity` bytes of address space up front (memory is
+// only committed as it is used) so that strings never move and documents
+// can refer to them by offset. Interning is thread-safe; reading interned
+// strings needs no locking.
+class StringPool {
+public:
+   static constexpr std::size_t maxCapacity = std::size_t(1) << 31;
+
+   explicit StringPool(std::size_t capacity = std::size_t(1) << 30);
+   StringPool(const StringPool &) = delete;
+   StringPool &operator=(const StringPool &) = delete;
+   ~StringPool();
+
+   // Interns many strings under one acquisition of the pool's lock.
+   class Session {
+   public:
+      explicit Session(StringPool &pool)
+         : pool(pool),
+           lock(pool.mutex)
+         { }
+
+      // Returns the offset of s, which must hash to `hash` (see hashKey()).
+      // Throws Exception if the pool is full.
+      std::uint32_t intern(std::string_view s, std::uint32_t hash)
+         { return pool.intern(s, hash); }
+
+   private:
+      StringPool &pool;
+      std::lock_guard<std::mutex> lock;
+   };
+
+   const char *data() const
+      { return base; }
+
+   // The number of distinct strings and the bytes they occupy
+   std::size_t count() const;
+   std::size_t size() const;
+
+private:
+   std::uint32_t intern(std::string_view s, std::uint32_t hash);
+
+   struct Entry {
+      std::uint32_t offset;
+      std::uint32_t length;
+   };
+
+   char *base = nullptr;
+   std::size_t capacity = 0;
+   std::size_t used = 0;
+   std::vector<Entry> entries;
+   std::vector<detail::IndexSlot> index;
+   mutable std::mutex mutex;
+};
+
+}
+
+#endif
\ No newline at end of file
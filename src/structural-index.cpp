@@ -0,0 +1,163 @@
+#include "structural-index.h"
+
+#include "exception.h"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CCM_TOML_X86 1
+#endif
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+constexpr array<bool, 256> makeStructuralTable() {
+   array<bool, 256> table{};
+   for (int c = 0; c < 256; ++c) {
+      table[c] = c < 0x20 || c >= 0x7f;
+   }
+   for (unsigned char c : "\"'\\#[]{}=,.") {
+      table[c] = true;
+   }
+   // The loop above also marks the string literal's terminating NUL, which is
+   // a control character anyway.
+   return table;
+}
+
+constexpr array<bool, 256> structural = makeStructuralTable();
+
+// Classifies a tail shorter than 64 bytes, or a whole window on machines
+// without SIMD.
+uint64_t scalarWord(const char *data, size_t size) {
+   uint64_t w = 0;
+   for (size_t i = 0; i < size; ++i) {
+      if (structural[static_cast<unsigned char>(data[i])]) {
+         w |= uint64_t(1) << i;
+      }
+   }
+   return w;
+}
+
+void buildScalar(const char *data, size_t size, uint64_t *bits) {
+   for (size_t i = 0; i < size; i += 64) {
+      *bits++ = scalarWord(data + i, min<size_t>(64, size - i));
+   }
+}
+
+#ifdef CCM_TOML_X86
+
+__attribute__((target("sse2")))
+uint32_t sse2Mask(const char *data) {
+   __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+   // Bytes >= 0x80 are negative as signed chars, so this one comparison
+   // catches both control characters and non-ASCII bytes.
+   __m128i m = _mm_cmplt_epi8(v, _mm_set1_epi8(0x20));
+   for (char c : { '\x7f', '"', '\'', '\\', '#', '[', ']', '{', '}', '=', ',',
+                   '.' })
+   {
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+   }
+   return static_cast<uint32_t>(_mm_movemask_epi8(m));
+}
+
+__attribute__((target("sse2")))
+void buildSSE2(const char *data, size_t size, uint64_t *bits) {
+   size_t i = 0;
+   for (; i + 64 <= size; i += 64) {
+      *bits++ = uint64_t(sse2Mask(data + i))
+                | uint64_t(sse2Mask(data + i + 16)) << 16
+                | uint64_t(sse2Mask(data + i + 32)) << 32
+                | uint64_t(sse2Mask(data + i + 48)) << 48;
+   }
+   if (i < size) {
+      *bits = scalarWord(data + i, size - i);
+   }
+}
+
+__attribute__((target("avx2")))
+uint32_t avx2Mask(const char *data) {
+   __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+   __m256i m = _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v);
+   for (char c : { '\x7f', '"', '\'', '\\', '#', '[', ']', '{', '}', '=', ',',
+                   '.' })
+   {
+      m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+   }
+   return static_cast<uint32_t>(_mm256_movemask_epi8(m));
+}
+
+__attribute__((target("avx2")))
+void buildAVX2(const char *data, size_t size, uint64_t *bits) {
+   size_t i = 0;
+   for (; i + 64 <= size; i += 64) {
+      *bits++ = uint64_t(avx2Mask(data + i))
+                | uint64_t(avx2Mask(data + i + 32)) << 32;
+   }
+   if (i < size) {
+      *bits = scalarWord(data + i, size - i);
+   }
+}
+
+#endif
+
+} // namespace
+
+bool StructuralIndex::supports(Impl impl) {
+   switch (impl) {
+   case Impl::Auto:
+   case Impl::Scalar:
+      return true;
+#ifdef CCM_TOML_X86
+   case Impl::SSE2:
+      return __builtin_cpu_supports("sse2");
+   case Impl::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+   default:
+      return false;
+   }
+}
+
+void StructuralIndex::reset(string_view input, Impl impl) {
+   if (impl == Impl::Auto) {
+      impl = supports(Impl::AVX2) ? Impl::AVX2
+             : supports(Impl::SSE2) ? Impl::SSE2
+             : Impl::Scalar;
+   }
+   else if (!supports(impl)) {
+      throw Exception("StructuralIndex: implementation not supported");
+   }
+
+   switch (impl) {
+#ifdef CCM_TOML_X86
+   case Impl::SSE2:
+      builder = buildSSE2;
+      break;
+   case Impl::AVX2:
+      builder = buildAVX2;
+      break;
+#endif
+   default:
+      builder = buildScalar;
+      break;
+   }
+
+   this->input = input;
+   windowStart = 0;
+   windowEnd = 0;
+}
+
+void StructuralIndex::build(size_t pos) {
+   windowStart = pos & ~size_t(63);
+   windowEnd = min(windowStart + window, input.size());
+   words = (windowEnd - windowStart + 63) / 64;
+   bits.resize(window / 64);
+   builder(input.data() + windowStart, windowEnd - windowStart, bits.data());
+}
+
+}
\ No newline at end of file
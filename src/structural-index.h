@@ -0,0 +1,82 @@
+#ifndef CCM_TOML_STRUCTURAL_INDEX_H
+#define CCM_TOML_STRUCTURAL_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace ccm::toml {
+
+// The first stage of tokenizing a contiguous buffer. The index is a bitmap
+// with one bit per input byte, set for every character the Tokenizer has to
+// look at individually:
+//
+//    " ' \ # [ ] { } = , . \r \n
+//
+// and for every byte that is not printable ASCII (control characters, DEL, and
+// bytes >= 0x80). Everything between two set bits is a run of ordinary
+// printable characters that the Tokenizer can consume in one step, which is
+// how it skips through comments and the bodies of long strings.
+//
+// The bitmap is built with SSE2 or AVX2 (chosen at runtime) in windows of
+// `window` bytes as the Tokenizer moves forward, so it stays small and hot in
+// cache no matter how large the input is.
+class StructuralIndex {
+public:
+   enum class Impl {
+      Auto,
+      Scalar,
+      SSE2,
+      AVX2
+   };
+
+   static constexpr std::size_t window = 64 * 1024;
+
+   StructuralIndex() = default;
+
+   void reset(std::string_view input, Impl impl=Impl::Auto);
+
+   // Returns the position of the first structural character at or after pos,
+   // or the size of the input if there is none. Positions must not move
+   // backwards by more than a window between calls.
+   std::size_t next(std::size_t pos) {
+      while (pos < input.size()) {
+         if (pos < windowStart || pos >= windowEnd) {
+            build(pos);
+         }
+         std::size_t word = (pos - windowStart) / 64;
+         std::uint64_t w = bits[word] & (~std::uint64_t(0) << (pos % 64));
+         while (w == 0) {
+            if (++word == words) {
+               break;
+            }
+            w = bits[word];
+         }
+         if (w != 0) {
+            return windowStart + word * 64 + __builtin_ctzll(w);
+         }
+         pos = windowEnd;
+      }
+      return input.size();
+   }
+
+   static bool supports(Impl impl);
+
+private:
+   using Builder = void (*)(const char *data, std::size_t size,
+                            std::uint64_t *bits);
+
+   void build(std::size_t pos);
+
+   std::string_view input;
+   Builder builder = nullptr;
+   std::vector<std::uint64_t> bits;
+   std::size_t words = 0;
+   std::size_t windowStart = 0;
+   std::size_t windowEnd = 0;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef CCM_TOML_SWAR_H
+#define CCM_TOML_SWAR_H
+
+#include "date-time.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace ccm::toml::swar {
+
+// SIMD-within-a-register helpers for the fixed-width digit groups of RFC 3339
+// dates and times. Eight input bytes are loaded into one 64-bit word (byte i
+// in bits 8i..8i+7) and validated and converted all at once.
+
+inline std::uint64_t load(const char *p) {
+   std::uint64_t v;
+   std::memcpy(&v, p, sizeof v);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+   v = __builtin_bswap64(v);
+#endif
+   return v;
+}
+
+inline std::uint64_t load2(const char *p) {
+   return static_cast<unsigned char>(p[0])
+          | static_cast<std::uint64_t>(static_cast<unsigned char>(p[1])) << 8;
+}
+
+// True if all eight bytes are ASCII decimal digits.
+inline bool allDigits(std::uint64_t v) {
+   return ((v & 0xF0F0F0F0F0F0F0F0)
+           | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+          == 0x3333333333333333;
+}
+
+// Converts eight digit bytes into four two-digit values, one in the low byte
+// of each 16-bit lane: "19790527" becomes lanes 19, 79, 05, 27.
+inline std::uint64_t pairs(std::uint64_t v) {
+   return (((v & 0x0F0F0F0F0F0F0F0F) * (10 * 256 + 1)) >> 8)
+          & 0x00FF00FF00FF00FF;
+}
+
+inline int lane(std::uint64_t pairs, int i) {
+   return static_cast<int>((pairs >> (16 * i)) & 0xFF);
+}
+
+// Parses "YYYY-MM-DD" from 10 bytes at p.
+inline bool parseDate(const char *p, Date &date) {
+   std::uint64_t v = load(p);    // "YYYY-MM-"
+   std::uint64_t dd = load2(p + 8);
+   if (((v >> 32) & 0xFF) != '-' || (v >> 56) != '-') {
+      return false;
+   }
+
+   // Squeeze out the dashes: "YYYYMMDD"
+   std::uint64_t digits = (v & 0xFFFFFFFF)
+                          | ((v >> 8) & 0xFFFF00000000)
+                          | dd << 48;
+   if (!allDigits(digits)) {
+      return false;
+   }
+
+   std::uint64_t p2 = pairs(digits);
+   date.year = lane(p2, 0) * 100 + lane(p2, 1);
+   date.month = lane(p2, 2);
+   date.day = lane(p2, 3);
+   return true;
+}
+
+// Parses "HH:MM:SS" from 8 bytes at p.
+inline bool parseTime(const char *p, Time &time) {
+   std::uint64_t v = load(p);
+   if (((v >> 16) & 0xFF) != ':' || ((v >> 40) & 0xFF) != ':') {
+      return false;
+   }
+
+   // Squeeze out the colons and pad: "HHMMSS00"
+   std::uint64_t digits = (v & 0xFFFF)
+                          | ((v >> 8) & 0xFFFF0000)
+                          | ((v >> 16) & 0xFFFF00000000)
+                          | std::uint64_t(0x3030) << 48;
+   if (!allDigits(digits)) {
+      return false;
+   }
+
+   std::uint64_t p2 = pairs(digits);
+   time.hour = lane(p2, 0);
+   time.minute = lane(p2, 1);
+   time.second = lane(p2, 2);
+   time.nanosecond = 0;
+   return true;
+}
+
+} // namespace ccm::toml::swar
+
+#endif
\ No newline at end of file
@@ -3,22 +3,28 @@
 
 #include "date-time.h"
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <variant>
 
 namespace ccm::toml {
 
+// A token's lexeme and string value are views. When the Tokenizer reads from a
+// contiguous source, they point directly into the source buffer (which must
+// outlive the token). Otherwise, and for strings whose escape sequences changed
+// them, the characters live in the token's own storage; copying or moving a
+// Token re-points those views at the new token's storage.
 struct Token {
    enum class Kind {
       // The token is a simple character. lexeme[0] contains the character.
       Char,
 
-      // The token represents an identifier. In most cases, lexeme and
-      // get<string>(value) both contain the identifier. However, when the ID is
-      // a string, lexeme contains the quote characters and escape sequences
-      // from the input, whereas get<string>(value) contains the actual ID to be
-      // used as a key.
+      // The token represents a bare identifier. lexeme and
+      // get<string_view>(value) both contain the identifier. Quoted keys are
+      // String tokens.
       Id,
 
       // The token is a contiguous seqeuence of non-newline whitespace (spaces
@@ -42,8 +48,8 @@ struct Token {
       // get<bool>(value) contains the boolean value.
       Boolean,
 
-      // The token is a fully parsed string. get<string>(value) contains the
-      // data that the string should contain.
+      // The token is a fully parsed string. get<string_view>(value) contains
+      // the data that the string should contain.
       String,
 
       // An RFC 3339 date with offset from UTC. get<DateTime>(value) contains
@@ -67,20 +73,114 @@ struct Token {
       ArrayTableOpen,
 
       // lexeme == "]]"
-      ArrayTableClose
+      ArrayTableClose,
+
+      // A number, date or time read while the Tokenizer was skimming (see
+      // Tokenizer::skim()). It has no value.
+      Skimmed
    };
 
    using Value = std::variant<std::int64_t,
                               double,
                               bool,
-                              std::string,
+                              std::string_view,
                               DateTime,
                               Date,
                               Time>;
 
+   Token() = default;
+
+   Token(const Token &other)
+      : kind(other.kind),
+        value(other.value),
+        lexeme(other.lexeme),
+        line(other.line),
+        col(other.col),
+        deferred(other.deferred),
+        storage(other.storage)
+      { relocate(other.storage.data(), other.storage.size()); }
+
+   Token(Token &&other) noexcept
+      : kind(other.kind),
+        value(other.value),
+        lexeme(other.lexeme),
+        line(other.line),
+        col(other.col),
+        deferred(other.deferred)
+   {
+      const char *old = other.storage.data();
+      std::size_t oldSize = other.storage.size();
+      storage = std::move(other.storage);
+      relocate(old, oldSize);
+   }
+
+   Token &operator=(const Token &other) {
+      if (this != &other) {
+         kind = other.kind;
+         value = other.value;
+         lexeme = other.lexeme;
+         line = other.line;
+         col = other.col;
+         deferred = other.deferred;
+         storage = other.storage;
+         relocate(other.storage.data(), other.storage.size());
+      }
+      return *this;
+   }
+
+   Token &operator=(Token &&other) noexcept {
+      if (this != &other) {
+         kind = other.kind;
+         value = other.value;
+         lexeme = other.lexeme;
+         line = other.line;
+         col = other.col;
+         deferred = other.deferred;
+         const char *old = other.storage.data();
+         std::size_t oldSize = other.storage.size();
+         storage = std::move(other.storage);
+         relocate(old, oldSize);
+      }
+      return *this;
+   }
+
    Kind kind;
    Value value;
-   std::string lexeme;
+   std::string_view lexeme;
+
+   // Where the token starts in the input, counting from 1
+   int line = 0;
+   int col = 0;
+
+   // Set if the Tokenizer left the value to be decoded later (see
+   // Tokenizer::lazy() and decodeValue()). A deferred String's value views
+   // its raw characters, escape sequences and all; a deferred Integer or
+   // Float has no value and is decoded from the lexeme.
+   bool deferred = false;
+
+   // Backing characters for lexeme and/or a string value that cannot be
+   // viewed in the source. Only the Tokenizer should write to this.
+   std::string storage;
+
+private:
+   // Re-points views that referred to [old, old + oldSize) at storage.
+   void relocate(const char *old, std::size_t oldSize) {
+      auto move = [&](std::string_view view) {
+         std::less_equal<const char *> le;
+         if (view.empty() || !le(old, view.data())
+             || !le(view.data() + view.size(), old + oldSize))
+         {
+            return view;
+         }
+         return std::string_view(storage.data() + (view.data() - old),
+                                 view.size());
+      };
+
+      lexeme = move(lexeme);
+      if (auto *s = std::get_if<std::string_view>(&value)) {
+         *s = move(*s);
+      }
+   }
 };
 
 }
@@ -1,53 +1,173 @@
 #ifndef CCM_TOML_TOKENIZER_H
 #define CCM_TOML_TOKENIZER_H
 
+#include "buffer-source.h"
 #include "exception.h"
 #include "lookahead-istream.h"
+#include "structural-index.h"
+#include "swar.h"
 #include "token.h"
+#include "utf8.h"
 
-#include <cctype>
+#include <array>
 #include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <istream>
 #include <limits>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ccm::toml {
 
-template<int NLookahead=1>
+// A source is contiguous if its whole input stays addressable, which it
+// advertises by providing
+//
+//    std::size_t position() const;                       // offset of peek(0)
+//    std::size_t size() const;                           // input length
+//    std::string_view slice(std::size_t, std::size_t) const;
+//    void advance(std::size_t n);                        // consume n chars
+//
+// Tokens read from a contiguous source view it directly instead of copying,
+// and the Tokenizer runs a StructuralIndex over it to consume runs of plain
+// characters in bulk.
+template<typename Source, typename = void>
+struct IsContiguousSource : std::false_type { };
+
+template<typename Source>
+struct IsContiguousSource<Source,
+      std::void_t<decltype(std::declval<const Source &>().slice(
+                             std::declval<const Source &>().position(), 0))>>
+   : std::true_type { };
+
+// Source is the input the Tokenizer reads characters from. It must provide
+//
+//    int get();                  // consume and return the next character
+//    int peek(std::size_t n=0);  // return the nth unconsumed character
+//
+// where characters are returned as unsigned char values and the end of input
+// is char_traits<char>::eof(). The Tokenizer never peeks further than a few
+// characters ahead. Sources may also be contiguous (see IsContiguousSource).
+// Built-in sources are LookaheadIStream (std::istream), BufferSource
+// (contiguous in-memory buffer), and FdSource (POSIX file descriptor). The
+// Tokenizer's constructor arguments are forwarded to the Source's constructor.
+template<int NLookahead=1, typename Source=LookaheadIStream>
 class Tokenizer {
    static_assert(NLookahead >= 0);
 
 public:
-   Tokenizer(std::istream &in)
-      : in(in)
+   template<typename... Args>
+   explicit Tokenizer(Args &&...args)
+      : in(std::forward<Args>(args)...)
       { }
 
+   static constexpr int lookaheadTokens = NLookahead;
+
+   // Starts over on a new input, with the Source constructed from `args` as
+   // by the constructor, keeping the memory that the last input needed.
+   // Tokens from the last input are no longer valid. The Source must be move
+   // assignable, as all the built-in sources are.
+   template<typename... Args>
+   void reset(Args &&...args) {
+      in = Source(std::forward<Args>(args)...);
+      head = 0;
+      count = 0;
+      current = nullptr;
+      state = State::Init;
+      context.assign(1, Context::Init);
+      lineNum = 1;
+      colNum = 1;
+      tokenStart = 0;
+      valueStart = 0;
+      valueLength = 0;
+      valueDecoded = false;
+      valueDeferred = false;
+      decodedValue.clear();
+      skimming = false;
+      deferring = false;
+   }
+
+   // Tokens are read on demand: more() reads up to NLookahead + 1 tokens
+   // ahead, and nothing more is read until more() or next() is called again.
    bool more()
    { 
-      if (state == State::Init) {
-         state = State::Key;
-         fillBuffer();
-      }
-      return !buffer.empty();
+      start();
+      fillBuffer();
+      return count > 0;
    }
 
-   Token next() {
+   // The returned token (and any views into its storage) remains valid until
+   // the next call to next(). Copy it to keep it longer.
+   const Token &next() {
       if (!more()) {
          throw Exception("Tokenizer::next(): no more tokens");
       }
-      Token t = buffer[0];
-      buffer.erase(buffer.begin());
-      fillBuffer();
+      const Token &t = slots[head];
+      head = (head + 1) % NSlots;
+      --count;
       return t;
    }
 
+   // Call more() first to read the tokens to peek at.
    const Token &peek(int which=0) const {
-      if (which < 0 || which >= buffer.size()) {
+      if (which < 0 || which >= count) {
          throw Exception("Tokenizer::peek(): " + std::to_string(which)
                          + " is out of range");
       }
-      return buffer[which];
+      return slots[(head + which) % NSlots];
+   }
+
+   // While skimming, the Tokenizer reads values only as far as it needs to
+   // find where they end: numbers, dates and times become Skimmed tokens and
+   // strings have empty values, with no escape sequences or digits decoded.
+   // This is for skipping parts of a document quickly. It applies to tokens
+   // read from then on, not to any that are already buffered.
+   void skim(bool on)
+      { skimming = on; }
+
+   // While lazy, the Tokenizer still checks every value but leaves the work
+   // of converting strings with escape sequences, integers and floats to
+   // whoever reads them: those tokens are marked deferred and decoded with
+   // decodeValue(). Dates and times are parsed as they are checked, in one
+   // pass, so they are never deferred. Like skim(), this applies to tokens
+   // read from then on.
+   void lazy(bool on)
+      { deferring = on; }
+
+   // For contiguous sources: where the next token will start, as an offset
+   // into the input and a line and column
+   std::size_t position() const
+      { return in.position(); }
+   int line() const
+      { return lineNum; }
+   int column() const
+      { return colNum; }
+
+   // For contiguous sources: moves ahead to `pos`, which is at line:col,
+   // without reading what is in between. Tokens read ahead are dropped. The
+   // arrays and inline tables the Tokenizer is in stay open, so what is
+   // passed over must leave them so.
+   void seek(std::size_t pos, int line, int col) {
+      static_assert(contiguous, "Only contiguous sources can seek");
+      start();
+      if (pos < in.position()) {
+         throw Exception("Tokenizer::seek(): can't move backwards");
+      }
+      in.advance(pos - in.position());
+      count = 0;
+      lineNum = line;
+      colNum = col;
+   }
+
+   // Carries on as if an array had just been opened, for reading some of a
+   // large array's elements on their own (see Reader::enterArray()).
+   void enterArray() {
+      start();
+      state = State::Value;
+      context.push_back(Context::Array);
    }
 
 private:
@@ -74,13 +194,38 @@ private:
       Id
    };
 
+   static constexpr bool contiguous = IsContiguousSource<Source>::value;
+
+   // Tokens live in a ring of slots that are reused in place, so their storage
+   // keeps its capacity from one token to the next. NLookahead + 1 slots hold
+   // the buffered tokens; one more holds the token last returned by next().
+   static constexpr int NSlots = NLookahead + 2;
+
+   void start();
    void fillBuffer();
+   Token &beginToken(Token::Kind kind);
+   void finishToken();
+   void beginValue();
+   void appendValue(char c);
+   void appendDecoded(char c);
+   void markDecoded();
+   std::string_view lexemeSoFar() const;
+   const char *lookahead(char *buf, std::size_t &n);
+   void consume(const char *chars, std::size_t n);
+   std::size_t skipPlainRun();
+   std::size_t appendPlainRun();
    bool getToken();
    void getBoolean();
    void getNumber();
+   void getSkimmed();
+   double parseFloat(bool underscores, int startLine, int startCol);
    void getDateTime();
    void getLocalTime();
    Time getTimePart();
+   bool getDateTimeFast(Token &token);
+   bool getLocalTimeFast(Token &token);
+   static std::size_t getFractionFast(const char *p, std::size_t n,
+                                      Time &time);
    void getNewlines();
    void getWhitespace();
    void getId();
@@ -97,30 +242,380 @@ private:
    std::string expect(const std::string &s);
    void throwUnexpectedCharacter(Character expectedCharClass) const;
 
-   static bool test(int c, Character charClass);
+   // What getToken() does with the first character of a token. There is one
+   // table per State.
+   enum class Lexer : std::uint8_t {
+      Error,
+      Newline,
+      Whitespace,
+      Comment,
+      BasicString,
+      LiteralString,
+      CloseInlineTable,
+      Id,
+      Equals,
+      KeyOpenBracket,
+      KeyCloseBracket,
+      Dot,
+      Digit,
+      Number,
+      Boolean,
+      OpenArray,
+      CloseArray,
+      OpenInlineTable,
+      Comma
+   };
+
+   // classes[c] has bit n set if c belongs to Character n. This is ASCII
+   // only and does not depend on the locale.
+   static constexpr std::array<std::uint8_t, 256> classes = [] {
+      std::array<std::uint8_t, 256> table{};
+      auto set = [&](int c, Character charClass) {
+         table[c] |= 1 << static_cast<int>(charClass);
+      };
+      for (int c = 0; c < 256; ++c) {
+         bool digit = c >= '0' && c <= '9';
+         bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+         // Any printable ASCII character, including spaces but excluding tabs,
+         // \r and \n
+         if (c >= 32 && c <= 126) {
+            set(c, Character::Printable);
+         }
+         if (digit) {
+            set(c, Character::DecimalDigit);
+         }
+         if (digit || c == '+' || c == '-') {
+            set(c, Character::DecimalDigitPlusMinus);
+         }
+         if (c == '0' || c == '1') {
+            set(c, Character::BinaryDigit);
+         }
+         if (c >= '0' && c <= '7') {
+            set(c, Character::OctalDigit);
+         }
+         if (digit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) {
+            set(c, Character::HexDigit);
+         }
+         if (c == ' ' || c == '\t') {
+            set(c, Character::Whitespace);
+         }
+         if (digit || alpha || c == '_' || c == '-') {
+            set(c, Character::Id);
+         }
+      }
+      return table;
+   }();
+
+   static constexpr std::array<std::array<Lexer, 256>, 3> dispatch = [] {
+      std::array<std::array<Lexer, 256>, 3> tables{};
+      auto &key = tables[static_cast<int>(State::Key)];
+      auto &value = tables[static_cast<int>(State::Value)];
+
+      for (auto *table : { &key, &value }) {
+         (*table)['\r'] = Lexer::Newline;
+         (*table)['\n'] = Lexer::Newline;
+         (*table)[' '] = Lexer::Whitespace;
+         (*table)['\t'] = Lexer::Whitespace;
+         (*table)['#'] = Lexer::Comment;
+         (*table)['"'] = Lexer::BasicString;
+         (*table)['\''] = Lexer::LiteralString;
+         (*table)['}'] = Lexer::CloseInlineTable;
+      }
+
+      for (int c = 0; c < 256; ++c) {
+         if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')
+             || (c >= 'A' && c <= 'Z') || c == '_' || c == '-')
+         {
+            key[c] = Lexer::Id;
+         }
+      }
+      key['='] = Lexer::Equals;
+      key['['] = Lexer::KeyOpenBracket;
+      key[']'] = Lexer::KeyCloseBracket;
+      key['.'] = Lexer::Dot;
+
+      for (int c = '0'; c <= '9'; ++c) {
+         value[c] = Lexer::Digit;
+      }
+      for (char c : { '+', '-', 'i', 'n' }) {
+         value[c] = Lexer::Number;
+      }
+      value['t'] = Lexer::Boolean;
+      value['f'] = Lexer::Boolean;
+      value['['] = Lexer::OpenArray;
+      value[']'] = Lexer::CloseArray;
+      value['{'] = Lexer::OpenInlineTable;
+      value[','] = Lexer::Comma;
+
+      // getToken() never runs in State::Init, but treat it like State::Key.
+      tables[static_cast<int>(State::Init)] = key;
+      return tables;
+   }();
+
+   // Powers of ten that are exactly representable as doubles
+   static constexpr double powersOfTen[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+      1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+   };
+
+   static bool test(int c, Character charClass) {
+      return c >= 0 && c < 256
+             && ((classes[c] >> static_cast<int>(charClass)) & 1);
+   }
 
-   LookaheadIStream in;
-   std::vector<Token> buffer;
+   Source in;
+   std::array<Token, NSlots> slots;
+   int head = 0;
+   int count = 0;
+   Token *current = nullptr;
    State state = State::Init;
    std::vector<Context> context = { Context::Init };
    int lineNum = 1;
    int colNum = 1;
+
+   // Bookkeeping for the token under construction. For contiguous sources the
+   // lexeme is the input between tokenStart and the current position, and a
+   // string value is a view of valueLength characters at valueStart unless an
+   // escape sequence forced it to be decoded into decodedValue. For other
+   // sources, valueStart is where the value starts in the token's storage.
+   // valueDeferred is set instead of valueDecoded when skimming or lazy.
+   StructuralIndex index;
+   std::size_t tokenStart = 0;
+   std::size_t valueStart = 0;
+   std::size_t valueLength = 0;
+   bool valueDecoded = false;
+   bool valueDeferred = false;
+   std::string decodedValue;
+   bool skimming = false;
+   bool deferring = false;
 };
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::fillBuffer() {
-   constexpr int bufferSize = NLookahead + 1;
-   while (buffer.size() < bufferSize && getToken())
-      ;
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::start() {
+   if (state == State::Init) {
+      state = State::Key;
+      if constexpr (contiguous) {
+         index.reset(in.slice(0, in.size()));
+      }
+   }
+}
+
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::fillBuffer() {
+   while (count < NLookahead + 1 && getToken()) {
+      finishToken();
+   }
+}
+
+template<int NLookahead, typename Source>
+Token &Tokenizer<NLookahead, Source>::beginToken(Token::Kind kind) {
+   Token &token = slots[(head + count) % NSlots];
+   ++count;
+   current = &token;
+   token.kind = kind;
+   token.value = Token::Value{};
+   token.line = lineNum;
+   token.col = colNum;
+   token.deferred = false;
+   token.storage.clear();
+   if constexpr (contiguous) {
+      tokenStart = in.position();
+   }
+   return token;
+}
+
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::finishToken() {
+   Token &token = *current;
+
+   // Append the string value to storage before taking any views of it, since
+   // appending may reallocate.
+   std::size_t lexemeSize = token.storage.size();
+   if (token.kind == Token::Kind::String) {
+      if (skimming) {
+         token.value = std::string_view();
+      }
+      else if (valueDeferred) {
+         // Only basic strings are deferred, so the value is the raw
+         // characters up to the closing quote(s).
+         std::size_t close = lexemeSoFar().substr(0, 3) == "\"\"\"" ? 3 : 1;
+         if constexpr (contiguous) {
+            token.value = in.slice(valueStart, in.position() - close);
+         }
+         else {
+            token.value = std::string_view(token.storage)
+                          .substr(valueStart, lexemeSize - valueStart - close);
+         }
+         token.deferred = true;
+      }
+      else if (contiguous && !valueDecoded) {
+         if constexpr (contiguous) {
+            token.value = in.slice(valueStart, valueStart + valueLength);
+         }
+      }
+      else {
+         token.storage += decodedValue;
+         token.value = std::string_view(token.storage).substr(lexemeSize);
+      }
+   }
+
+   if constexpr (contiguous) {
+      token.lexeme = in.slice(tokenStart, in.position());
+   }
+   else {
+      token.lexeme = std::string_view(token.storage).substr(0, lexemeSize);
+   }
+
+   if (token.kind == Token::Kind::Id) {
+      token.value = token.lexeme;
+   }
+}
+
+// Starts the value of a string token at the current position.
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::beginValue() {
+   if constexpr (contiguous) {
+      valueStart = in.position();
+   }
+   else {
+      valueStart = current->storage.size();
+   }
+   valueLength = 0;
+   valueDecoded = false;
+   valueDeferred = false;
+   decodedValue.clear();
+}
+
+// Appends a character that was copied verbatim from the input to the string
+// value.
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::appendValue(char c) {
+   if ((!contiguous || valueDecoded) && !valueDeferred && !skimming) {
+      decodedValue += c;
+   }
+   ++valueLength;
+}
+
+// Appends a character that does not appear verbatim in the input (the result
+// of an escape sequence, for instance) to the string value.
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::appendDecoded(char c) {
+   markDecoded();
+   if (valueDecoded) {
+      decodedValue += c;
+   }
+}
+
+// Returns the characters consumed so far for the token under construction.
+template<int NLookahead, typename Source>
+std::string_view Tokenizer<NLookahead, Source>::lexemeSoFar() const {
+   if constexpr (contiguous) {
+      return in.slice(tokenStart, in.position());
+   }
+   else {
+      return current->storage;
+   }
+}
+
+// Makes up to n upcoming characters addressable without consuming them and
+// sets n to the number available. For contiguous sources the result points
+// into the input; otherwise the characters are copied into buf.
+template<int NLookahead, typename Source>
+const char *Tokenizer<NLookahead, Source>::lookahead(char *buf,
+                                                     std::size_t &n)
+{
+   if constexpr (contiguous) {
+      std::size_t pos = in.position();
+      n = std::min(n, in.size() - pos);
+      return in.slice(pos, pos + n).data();
+   }
+   else {
+      for (std::size_t i = 0; i < n; ++i) {
+         int c = in.peek(i);
+         if (c == std::char_traits<char>::eof()) {
+            n = i;
+            break;
+         }
+         buf[i] = static_cast<char>(c);
+      }
+      return buf;
+   }
+}
+
+// Consumes n characters previously obtained from lookahead(). They must not
+// include a newline.
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::consume(const char *chars, std::size_t n) {
+   if constexpr (contiguous) {
+      in.advance(n);
+   }
+   else {
+      for (std::size_t i = 0; i < n; ++i) {
+         in.get();
+      }
+      current->storage.append(chars, n);
+   }
+   colNum += n;
+}
+
+// Consumes the run of plain printable characters (see StructuralIndex) at the
+// current position, returning its length. Such a run never contains a newline.
+// Returns 0 without consuming anything for sources that are not contiguous.
+template<int NLookahead, typename Source>
+std::size_t Tokenizer<NLookahead, Source>::skipPlainRun() {
+   if constexpr (contiguous) {
+      std::size_t pos = in.position();
+      std::size_t run = index.next(pos) - pos;
+      in.advance(run);
+      colNum += run;
+      return run;
+   }
+   return 0;
+}
+
+// Like skipPlainRun(), but also appends the run to the string value.
+template<int NLookahead, typename Source>
+std::size_t Tokenizer<NLookahead, Source>::appendPlainRun() {
+   if constexpr (contiguous) {
+      std::size_t pos = in.position();
+      std::size_t run = skipPlainRun();
+      if (valueDecoded) {
+         auto raw = in.slice(pos, pos + run);
+         decodedValue.append(raw.data(), raw.size());
+      }
+      valueLength += run;
+      return run;
+   }
+   return 0;
+}
+
+// Notes that the string value no longer matches the input, so from here on it
+// must be built in decodedValue, unless it isn't being built at all.
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::markDecoded() {
+   if (valueDecoded || valueDeferred) {
+      return;
+   }
+   if (skimming || deferring) {
+      valueDeferred = true;
+   }
+   else {
+      valueDecoded = true;
+      if constexpr (contiguous) {
+         auto raw = in.slice(valueStart, valueStart + valueLength);
+         decodedValue.assign(raw.data(), raw.size());
+      }
+   }
 }
 
-template<int NLookahead>
-bool Tokenizer<NLookahead>::getToken() {
+template<int NLookahead, typename Source>
+bool Tokenizer<NLookahead, Source>::getToken() {
    int c = in.peek();
    if (c == std::char_traits<char>::eof())
       return false;
 
-   if (c == '\r' || c == '\n') {
+   switch (dispatch[static_cast<int>(state)][c]) {
+   case Lexer::Newline:
       if (context.back() == Context::InlineTable) {
          throw SyntaxError("Unexpected newline in inline table",
                            lineNum, colNum);
@@ -130,26 +625,20 @@ bool Tokenizer<NLookahead>::getToken() {
       }
       getNewlines();
       return true;
-   }
-   if (test(c, Character::Whitespace)) {
+   case Lexer::Whitespace:
       getWhitespace();
       return true;
-   }
-   if (c == '#') {
+   case Lexer::Comment:
       getComment();
       return true;
-   }
-   if (c == '"') {
+   case Lexer::BasicString:
       getBasicString();
       return true;
-   }
-   if (c == '\'') {
+   case Lexer::LiteralString:
       getLiteralString();
       return true;
-   }
-   if (c == '}') {
-      // We would put this case in the State::Value section, but you can
-      // actually encounter a '}' in both value and key states (empty table).
+   case Lexer::CloseInlineTable:
+      // You can encounter a '}' in both value and key states (empty table).
       if (context.back() != Context::InlineTable) {
          throw SyntaxError("Unexpected '}'", lineNum, colNum);
       }
@@ -157,121 +646,125 @@ bool Tokenizer<NLookahead>::getToken() {
       context.pop_back();
       getChar();
       return true;
-   }
 
-   static const std::string keyChars = ".[]";
-   if (state == State::Key) {
-      if (test(c, Character::Id)) {
-         getId();
-         return true;
+   // Key state
+   case Lexer::Id:
+      getId();
+      return true;
+   case Lexer::Equals:
+      state = State::Value;
+      getChar();
+      return true;
+   case Lexer::KeyOpenBracket:
+      if (in.peek(1) == '[') {
+         beginToken(Token::Kind::ArrayTableOpen);
+         expect("[[");
       }
-      if (c == '=') {
-         state = State::Value;
+      else {
          getChar();
-         return true;
       }
-      if (c == '[' && in.peek(1) == '[') {
-         auto &token = buffer.emplace_back();
-         token.kind = Token::Kind::ArrayTableOpen;
-         token.lexeme = expect("[[");
-         return true;
-      }
-      if (c == ']' && in.peek(1) == ']') {
-         auto &token = buffer.emplace_back();
-         token.kind = Token::Kind::ArrayTableClose;
-         token.lexeme = expect("]]");
-         return true;
+      return true;
+   case Lexer::KeyCloseBracket:
+      if (in.peek(1) == ']') {
+         beginToken(Token::Kind::ArrayTableClose);
+         expect("]]");
       }
-      if (keyChars.find(c) != std::string::npos) {
+      else {
          getChar();
-         return true;
-      }
-   }
-   else {
-      if (test(in.peek(0), Character::DecimalDigit)
-          && test(in.peek(1), Character::DecimalDigit)
-          && test(in.peek(2), Character::DecimalDigit)
-          && test(in.peek(3), Character::DecimalDigit)
-          && in.peek(4) == '-')
-      {
-         // We check for dates and times first since they can be confused for
-         // numbers.
-         getDateTime();
-         return true;
-      }
-      else if (test(in.peek(0), Character::DecimalDigit)
-               && test(in.peek(1), Character::DecimalDigit)
-               && in.peek(2) == ':')
-      {
-         getLocalTime();
-         return true;
       }
-      else if (test(c, Character::DecimalDigitPlusMinus) || c == 'i'
-               || c == 'n')
-      {
-         // includes `inf` and `nan` floats
-         getNumber();
+      return true;
+   case Lexer::Dot:
+      getChar();
+      return true;
+
+   // Value state
+   case Lexer::Digit:
+      if (skimming) {
+         getSkimmed();
          return true;
       }
-      else if (c == 't' || c == 'f') {
-         getBoolean();
-         return true;
+      // Dates and times can be confused for numbers, so look for the '-' of
+      // YYYY-MM-DD or the ':' of HH:MM:SS first.
+      if (test(in.peek(1), Character::DecimalDigit)) {
+         int c2 = in.peek(2);
+         if (c2 == ':') {
+            getLocalTime();
+            return true;
+         }
+         if (test(c2, Character::DecimalDigit)
+             && test(in.peek(3), Character::DecimalDigit)
+             && in.peek(4) == '-')
+         {
+            getDateTime();
+            return true;
+         }
       }
-      else if (c == '[') {
-         context.push_back(Context::Array);
-         getChar();
+      getNumber();
+      return true;
+   case Lexer::Number:
+      if (skimming) {
+         getSkimmed();
          return true;
       }
-      else if (c == ']') {
-         if (context.back() != Context::Array) {
-            throw SyntaxError("Unexpected ']'", lineNum, colNum);
-         }
-         context.pop_back();
-         getChar();
-         return true;
+      // includes `inf` and `nan` floats
+      getNumber();
+      return true;
+   case Lexer::Boolean:
+      getBoolean();
+      return true;
+   case Lexer::OpenArray:
+      context.push_back(Context::Array);
+      getChar();
+      return true;
+   case Lexer::CloseArray:
+      if (context.back() != Context::Array) {
+         throw SyntaxError("Unexpected ']'", lineNum, colNum);
       }
-      else if (c == '{') {
+      context.pop_back();
+      getChar();
+      return true;
+   case Lexer::OpenInlineTable:
+      state = State::Key;
+      context.push_back(Context::InlineTable);
+      getChar();
+      return true;
+   case Lexer::Comma:
+      if (context.back() == Context::InlineTable) {
          state = State::Key;
-         context.push_back(Context::InlineTable);
-         getChar();
-         return true;
       }
-      else if (c == ',') {
-         if (context.back() == Context::InlineTable) {
-            state = State::Key;
-         }
-         else if (context.back() == Context::Init) {
-            throw SyntaxError("Unexpected ','", lineNum, colNum);
-         }
-         getChar();
-         return true;
+      else if (context.back() == Context::Init) {
+         throw SyntaxError("Unexpected ','", lineNum, colNum);
       }
+      getChar();
+      return true;
+
+   case Lexer::Error:
+      break;
    }
 
    throw SyntaxError("Unexpected character", lineNum, colNum);
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getBoolean() {
-   auto &token = buffer.emplace_back();
-   token.kind = Token::Kind::Boolean;
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getBoolean() {
+   Token &token = beginToken(Token::Kind::Boolean);
 
    if (in.peek() == 't') {
-      token.lexeme += expect("true");
+      expect("true");
       token.value = true;
    }
    else {
-      token.lexeme += expect("false");
+      expect("false");
       token.value = false;
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getNumber() {
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getNumber() {
    int startLine = lineNum;
    int startCol = colNum;
 
-   Token &token = buffer.emplace_back();
+   Token &token = beginToken(Token::Kind::Integer);
 
    // Let's get inf and nan out of the way...
    if (in.peek(0) == 'i'
@@ -281,12 +774,12 @@ void Tokenizer<NLookahead>::getNumber() {
       bool neg = false;
       if (in.peek(0) == '-') {
          neg = true;
-         token.lexeme += expect('-');
+         expect('-');
       }
       else if (in.peek(0) == '+') {
-         token.lexeme += expect('+');
+         expect('+');
       }
-      token.lexeme += expect("inf");
+      expect("inf");
       token.kind = Token::Kind::Float;
       token.value = std::numeric_limits<double>::infinity();
       if (neg) {
@@ -301,12 +794,12 @@ void Tokenizer<NLookahead>::getNumber() {
       bool neg = false;
       if (in.peek(0) == '-') {
          neg = true;
-         token.lexeme += expect('-');
+         expect('-');
       }
       else if (in.peek(0) == '+') {
-         token.lexeme += expect('+');
+         expect('+');
       }
-      token.lexeme += expect("nan");
+      expect("nan");
       token.kind = Token::Kind::Float;
       token.value = std::numeric_limits<double>::quiet_NaN();
       if (neg) {
@@ -315,15 +808,46 @@ void Tokenizer<NLookahead>::getNumber() {
       return;
    }
 
-   token.lexeme += expect(Character::DecimalDigitPlusMinus);
-
-   // num will contain only the characters that are necessary to parse the
-   // number.
-   std::string num;
+   char first = expect(Character::DecimalDigitPlusMinus);
+   bool negative = (first == '-');
    int base = 10;
    Character digitType = Character::DecimalDigit;
 
-   if (token.lexeme[0] == '0') {
+   // The magnitude of an integer, or the significand of a float, is
+   // accumulated as the digits go by. For decimal numbers, significantDigits
+   // counts digits after any leading zeros; past 19 of them, the value no
+   // longer fits and `mantissa` stops changing. Non-decimal integers flag
+   // overflow as soon as it happens. While lazy, only the syntax is checked.
+   std::uint64_t mantissa = 0;
+   int significantDigits = 0;
+   bool overflow = false;
+   bool underscores = false;
+
+   auto addDigit = [&](char digit) {
+      if (deferring) {
+         return;
+      }
+      unsigned d = digit <= '9' ? digit - '0' : (digit | 0x20) - 'a' + 10;
+      if (base == 10) {
+         if (significantDigits < 19) {
+            mantissa = mantissa * 10 + d;
+         }
+         if (mantissa != 0) {
+            ++significantDigits;
+         }
+      }
+      else if (mantissa > static_cast<std::uint64_t>(
+                             std::numeric_limits<std::int64_t>::max() - d)
+                          / base)
+      {
+         overflow = true;
+      }
+      else {
+         mantissa = mantissa * base + d;
+      }
+   };
+
+   if (first == '0') {
       int c = in.peek();
       switch (c) {
       case 'b':
@@ -341,22 +865,10 @@ void Tokenizer<NLookahead>::getNumber() {
       }
 
       if (base != 10) {
-         // Binary, octal, and hex numbers can have leading zeros. Scoop up the
-         // prefix, the first digit, and the rest of the leading zeros (if any)
-         token.lexeme += expect(c);
-         token.lexeme += expect(digitType);
-         if (token.lexeme.back() != '0') {
-            num += token.lexeme.back();
-         }
-         else {
-            c = in.peek();
-            while (c == '0') {
-               token.lexeme += expect('0');
-               c = in.peek();
-            }
-            // okay... there's a chance that leading zeros are the only digits,
-            // so remember that for later.
-         }
+         // Binary, octal, and hex numbers can have leading zeros, which
+         // accumulate harmlessly.
+         expect(static_cast<char>(c));
+         addDigit(expect(digitType));
       }
       else if (test(c, Character::DecimalDigit)) {
          // But decimal integers generally cannot have leading zeros. So let's
@@ -367,70 +879,65 @@ void Tokenizer<NLookahead>::getNumber() {
 
    // If we start with a '+' or '-', we MUST be followed by a decimal digit,
    // AND, if that digit is zero, it must be the only digit.
-   else if (token.lexeme[0] == '+' || token.lexeme[0] == '-') {
-      if (token.lexeme[0] == '-') {
-         num += '-';
-      }
-      token.lexeme += expect(Character::DecimalDigit);
-      if (token.lexeme.back() == '0'
-          && test(in.peek(), Character::DecimalDigit))
-      {
+   else if (first == '+' || first == '-') {
+      char digit = expect(Character::DecimalDigit);
+      if (digit == '0' && test(in.peek(), Character::DecimalDigit)) {
          throw SyntaxError("Integer has leading zero(s)", lineNum, colNum);
       }
-
-      if (token.lexeme.back() != '0') {
-         num += token.lexeme.back();
-      }
+      addDigit(digit);
    }
 
    // Otherwise we got a nonzero decimal digit
    else {
-      num += token.lexeme.back();
+      addDigit(first);
    }
 
-   // At this point, we have determined the base of the number. If the base is
-   // not 10, then the prefix and any leading zeros have been ignored. In some
-   // cases, a nonzero digit may have already been extracted. If so, it has been
-   // appended to the lexeme and `num`.
-
    int c = in.peek();
 
    // Slurp up the remaining digits. In the loop condition, we allow any digit
    // no matter what base we're parsing, but inside the loop we expect digits of
    // the appropriate base. This makes for some good error messages if the user
    // accidentally mixes bases.
-   while (c != std::char_traits<char>::eof()
-          && (test(c, Character::HexDigit) || c == '_'))
-   {
+   while (test(c, Character::HexDigit) || c == '_') {
       // ...but since 'e' and 'E' are considered hex digits, they get flagged
-      // here even though we expect them to appear in some floating point
-      // numbers! So if we see an e/E, we'll break so we can start parsing a
-      // float.
-      if (c == 'e' || c == 'E') {
+      // here even though we expect them to appear in some decimal floating
+      // point numbers! So if we see an e/E, we'll break so we can start
+      // parsing a float.
+      if (base == 10 && (c == 'e' || c == 'E')) {
          break;
       }
       else if (c == '_') {
-         token.lexeme += expect('_');
-         token.lexeme += expect(digitType);
+         expect('_');
+         underscores = true;
       }
-      else {
-         token.lexeme += expect(digitType);
-      }
-      num += token.lexeme.back();
+      addDigit(expect(digitType));
       c = in.peek();
    }
 
-   // Remember it's possible to end up with an empty `num` string if a non-base-
-   // 10 number contained only leading zeros.
-   if (num.empty()) {
-      num += '0';
-   }
-
    if (base == 10 && (c == '.' || c == 'e' || c == 'E')) {
       // A decimal integer followed by a '.' or e/E indicates a floating point
-      // number.
+      // number. The value is mantissa * 10^exponent.
       bool gotFraction = false;
       bool gotExponent = false;
+      int exponent = 0;
+      int explicitExponent = 0;
+      bool negativeExponent = false;
+
+      auto addFloatDigit = [&](char digit) {
+         if (gotExponent) {
+            // Anything this large is out of range anyway; just don't overflow.
+            if (explicitExponent < 100000) {
+               explicitExponent = explicitExponent * 10 + (digit - '0');
+            }
+         }
+         else {
+            addDigit(digit);
+            if (gotFraction) {
+               --exponent;
+            }
+         }
+      };
+
       // Remember: 'e' and 'E' are hex digits :)
       while (test(c, Character::HexDigit) || c == '.' || c == '_')
       {
@@ -444,11 +951,9 @@ void Tokenizer<NLookahead>::getNumber() {
                                  "decimal point", lineNum, colNum);
             }
             else {
-               token.lexeme += expect('.');
-               num += '.';
-               token.lexeme += expect(Character::DecimalDigit);
-               num += token.lexeme.back();
+               expect('.');
                gotFraction = true;
+               addFloatDigit(expect(Character::DecimalDigit));
             }
          }
          else if (c == 'e' || c == 'E') {
@@ -457,66 +962,143 @@ void Tokenizer<NLookahead>::getNumber() {
                                  "exponent part", lineNum, colNum);
             }
             else {
-               token.lexeme += expect(c);
-               num += c;
-               token.lexeme += expect(Character::DecimalDigitPlusMinus);
-               num += token.lexeme.back();
-               if (!test(token.lexeme.back(), Character::DecimalDigit)) {
-                  token.lexeme += expect(Character::DecimalDigit);
-                  num += token.lexeme.back();
-               }
+               expect(static_cast<char>(c));
                gotExponent = true;
+               char sign = expect(Character::DecimalDigitPlusMinus);
+               if (test(sign, Character::DecimalDigit)) {
+                  addFloatDigit(sign);
+               }
+               else {
+                  negativeExponent = (sign == '-');
+                  addFloatDigit(expect(Character::DecimalDigit));
+               }
             }
          }
          else if (c == '_') {
-            token.lexeme += expect('_');
-            token.lexeme += expect(Character::DecimalDigit);
-            num += token.lexeme.back();
+            expect('_');
+            underscores = true;
+            addFloatDigit(expect(Character::DecimalDigit));
          }
          else {
-            token.lexeme += expect(Character::DecimalDigit);
-            num += token.lexeme.back();
+            addFloatDigit(expect(Character::DecimalDigit));
          }
 
          c = in.peek();
       }
 
+      token.kind = Token::Kind::Float;
+      if (deferring) {
+         token.deferred = true;
+         return;
+      }
+
+      exponent += negativeExponent ? -explicitExponent : explicitExponent;
+
       double value = 0;
-      auto result = std::from_chars(num.c_str(),
-                                    num.c_str() + num.size(),
-                                    value);
-      if (result.ec == std::errc::result_out_of_range) {
-         throw SyntaxError("Floating point overflow/underflow",
-                           startLine, startCol);
+      if (significantDigits <= 19 && mantissa <= (std::uint64_t(1) << 53)
+          && exponent >= -22 && exponent <= 22)
+      {
+         // Both the significand and the power of ten are exactly
+         // representable, so one correctly rounded operation gives the
+         // correctly rounded result (Clinger's fast path).
+         value = static_cast<double>(mantissa);
+         if (exponent < 0) {
+            value /= powersOfTen[-exponent];
+         }
+         else {
+            value *= powersOfTen[exponent];
+         }
       }
-      else if (result.ec != std::errc{}) {
-         throw Exception("Could not parse floating point number");
+      else {
+         value = parseFloat(underscores, startLine, startCol);
       }
 
-      token.kind = Token::Kind::Float;
-      token.value = value;
+      token.value = negative ? -value : value;
+   }
+   else if (deferring) {
+      token.deferred = true;
    }
    else {
-      int64_t value = 0;
-      auto result = std::from_chars(num.c_str(),
-                                    num.c_str() + num.size(),
-                                    value,
-                                    base);
-      if (result.ec == std::errc::result_out_of_range) {
-         throw SyntaxError("Integer overflows 64 bits", startLine, startCol);
+      if (base == 10) {
+         std::uint64_t limit = std::numeric_limits<std::int64_t>::max();
+         overflow = significantDigits > 19 || mantissa > limit + negative;
       }
-      else if (result.ec != std::errc{}) {
-         throw Exception("Could not parse integer");
+      if (overflow) {
+         throw SyntaxError("Integer overflows 64 bits", startLine, startCol);
       }
 
       token.kind = Token::Kind::Integer;
-      token.value = value;
+      token.value = static_cast<std::int64_t>(negative ? 0 - mantissa
+                                                       : mantissa);
+   }
+}
+
+// Reads a number, date or time without decoding it, while skimming. Nothing
+// looks at the value, so any run of the characters they can contain will do.
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getSkimmed() {
+   beginToken(Token::Kind::Skimmed);
+   int c = in.peek();
+   while (true) {
+      while (test(c, Character::Id) || c == '.' || c == ':' || c == '+') {
+         expect(static_cast<char>(c));
+         c = in.peek();
+      }
+
+      // A date may be followed by a space and a time, as getDateTime()
+      // reads it: 1979-05-27 07:32:00.
+      std::string_view lexeme = lexemeSoFar();
+      if (c != ' ' || !test(in.peek(1), Character::DecimalDigit)
+          || lexeme.size() != 10 || lexeme[4] != '-' || lexeme[7] != '-')
+      {
+         return;
+      }
+      expect(' ');
+      c = in.peek();
+   }
+}
+
+// Parses the magnitude of the float lexed so far with std::from_chars, which
+// handles the cases the fast path in getNumber() cannot. The lexeme is parsed
+// in place unless it contains underscores.
+template<int NLookahead, typename Source>
+double Tokenizer<NLookahead, Source>::parseFloat(bool underscores,
+                                                 int startLine, int startCol)
+{
+   std::string_view text = lexemeSoFar();
+   if (text[0] == '+' || text[0] == '-') {
+      text.remove_prefix(1);
+   }
+
+   if (underscores) {
+      decodedValue.clear();
+      for (char c : text) {
+         if (c != '_') {
+            decodedValue += c;
+         }
+      }
+      text = decodedValue;
+   }
+
+   double value = 0;
+   auto result = std::from_chars(text.data(), text.data() + text.size(),
+                                 value);
+   if (result.ec == std::errc::result_out_of_range) {
+      throw SyntaxError("Floating point overflow/underflow",
+                        startLine, startCol);
+   }
+   else if (result.ec != std::errc{}) {
+      throw Exception("Could not parse floating point number");
    }
+   return value;
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getDateTime() {
-   auto &token = buffer.emplace_back();
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getDateTime() {
+   Token &token = beginToken(Token::Kind::LocalDate);
+   if (getDateTimeFast(token)) {
+      return;
+   }
 
    DateTime dateTime;
    std::string buf;
@@ -525,27 +1107,24 @@ void Tokenizer<NLookahead>::getDateTime() {
    for (int i = 0; i < 4; ++i) {
       buf += expect(Character::DecimalDigit);
    }
-   token.lexeme += buf;
    dateTime.date.year = std::stoi(buf);
    buf.clear();
 
-   token.lexeme += expect('-');
+   expect('-');
 
    // Get the month
    for (int i = 0; i < 2; ++i) {
       buf += expect(Character::DecimalDigit);
    }
-   token.lexeme += buf;
    dateTime.date.month = std::stoi(buf);
    buf.clear();
 
-   token.lexeme += expect('-');
+   expect('-');
 
    // Get the day
    for (int i = 0; i < 2; ++i) {
       buf += expect(Character::DecimalDigit);
    }
-   token.lexeme += buf;
    dateTime.date.day = std::stoi(buf);
    buf.clear();
 
@@ -553,32 +1132,30 @@ void Tokenizer<NLookahead>::getDateTime() {
    if (c == ' ' && test(in.peek(1), Character::DecimalDigit)
        || c == 't' || c == 'T')
    {
-      token.lexeme += expect(c);
+      expect(static_cast<char>(c));
       dateTime.time = getTimePart();
       c = in.peek();
       if (c == 'Z' || c == 'z') {
-         token.lexeme += expect(c);
+         expect(static_cast<char>(c));
          dateTime.offset = DateTime::Offset{};
       }
       else if (c == '+' || c == '-') {
-         token.lexeme += expect(c);
+         expect(static_cast<char>(c));
          dateTime.offset = DateTime::Offset{};
          dateTime.offset->negative = (c == '-');
          // Get the hours
          for (int i = 0; i < 2; ++i) {
             buf += expect(Character::DecimalDigit);
          }
-         token.lexeme += buf;
          dateTime.offset->hours = std::stoi(buf);
          buf.clear();
 
-         token.lexeme += expect(':');
+         expect(':');
 
          // Get the minutes
          for (int i = 0; i < 2; ++i) {
             buf += expect(Character::DecimalDigit);
          }
-         token.lexeme += buf;
          dateTime.offset->minutes = std::stoi(buf);
       }
 
@@ -597,10 +1174,13 @@ void Tokenizer<NLookahead>::getDateTime() {
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getLocalTime() {
-   auto &token = buffer.emplace_back();
-   token.kind = Token::Kind::LocalTime;
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getLocalTime() {
+   Token &token = beginToken(Token::Kind::LocalTime);
+   if (getLocalTimeFast(token)) {
+      return;
+   }
+
    auto &time = token.value.emplace<Time>();
    time = getTimePart();
    int c = in.peek();
@@ -609,9 +1189,8 @@ void Tokenizer<NLookahead>::getLocalTime() {
    }
 }
 
-template<int NLookahead>
-Time Tokenizer<NLookahead>::getTimePart() {
-   auto &token = buffer.back();
+template<int NLookahead, typename Source>
+Time Tokenizer<NLookahead, Source>::getTimePart() {
    Time time;
 
    std::string buf;
@@ -620,33 +1199,30 @@ Time Tokenizer<NLookahead>::getTimePart() {
    for (int i = 0; i < 2; ++i) {
       buf += expect(Character::DecimalDigit);
    }
-   token.lexeme += buf;
    time.hour = std::stoi(buf);
    buf.clear();
 
-   token.lexeme += expect(':');
+   expect(':');
 
    // Get minute
    for (int i = 0; i < 2; ++i) {
       buf += expect(Character::DecimalDigit);
    }
-   token.lexeme += buf;
    time.minute = std::stoi(buf);
    buf.clear();
 
-   token.lexeme += expect(':');
+   expect(':');
 
    // Get second
    for (int i = 0; i < 2; ++i) {
       buf += expect(Character::DecimalDigit);
    }
-   token.lexeme += buf;
    time.second = std::stoi(buf);
    buf.clear();
 
    // Get optional fractional seconds
    if (in.peek() == '.') {
-      token.lexeme += expect('.');
+      expect('.');
       buf += expect(Character::DecimalDigit);
       // We support nanoseconds precision (up to .999999999)
       int c = in.peek();
@@ -654,7 +1230,6 @@ Time Tokenizer<NLookahead>::getTimePart() {
          buf += expect(Character::DecimalDigit);
          c = in.peek();
       }
-      token.lexeme += buf;
       while (buf.size() < 9) {
          // Right pad buf with zeros before we use stoi()
          buf += '0';
@@ -665,10 +1240,140 @@ Time Tokenizer<NLookahead>::getTimePart() {
    return time;
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getNewlines() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::Newline;
+// Handles the common shapes of date-times in one go: YYYY-MM-DD, optionally
+// followed by [Tt ]HH:MM:SS, optional fractional seconds and an optional Z or
+// +HH:MM offset. Returns false without consuming anything if the input is
+// anything else, leaving getDateTime() to deal with it (and report errors).
+template<int NLookahead, typename Source>
+bool Tokenizer<NLookahead, Source>::getDateTimeFast(Token &token) {
+   // YYYY-MM-DDTHH:MM:SS.nnnnnnnnn+HH:MM, plus one to see what follows
+   constexpr std::size_t maxLength = 36;
+   char buf[maxLength];
+   std::size_t n = maxLength;
+   const char *p = lookahead(buf, n);
+
+   DateTime dateTime;
+   if (n < 10 || !swar::parseDate(p, dateTime.date)) {
+      return false;
+   }
+
+   std::size_t len = 10;
+   char sep = n > len ? p[len] : '\0';
+   bool timeFollows = sep == 'T' || sep == 't'
+                      || (sep == ' ' && n > len + 1
+                          && test(p[len + 1], Character::DecimalDigit));
+   if (!timeFollows) {
+      token.kind = Token::Kind::LocalDate;
+      token.value = dateTime.date;
+      consume(p, len);
+      return true;
+   }
+
+   ++len;
+   if (n < len + 8 || !swar::parseTime(p + len, dateTime.time)) {
+      return false;
+   }
+   len += 8;
+
+   if (n > len && p[len] == '.') {
+      std::size_t fraction = getFractionFast(p + len, n - len, dateTime.time);
+      if (fraction == 0) {
+         return false;
+      }
+      len += fraction;
+   }
+
+   char c = n > len ? p[len] : '\0';
+   if (c == 'Z' || c == 'z') {
+      dateTime.offset = DateTime::Offset{};
+      ++len;
+   }
+   else if (c == '+' || c == '-') {
+      // +HH:MM
+      const char *o = p + len;
+      if (n < len + 6 || o[3] != ':'
+          || !test(o[1], Character::DecimalDigit)
+          || !test(o[2], Character::DecimalDigit)
+          || !test(o[4], Character::DecimalDigit)
+          || !test(o[5], Character::DecimalDigit))
+      {
+         return false;
+      }
+      dateTime.offset = DateTime::Offset{};
+      dateTime.offset->negative = (c == '-');
+      dateTime.offset->hours = (o[1] - '0') * 10 + (o[2] - '0');
+      dateTime.offset->minutes = (o[4] - '0') * 10 + (o[5] - '0');
+      len += 6;
+   }
+
+   token.kind = dateTime.offset ? Token::Kind::OffsetDateTime
+                                : Token::Kind::LocalDateTime;
+   token.value = dateTime;
+   consume(p, len);
+   return true;
+}
+
+// The fast path for HH:MM:SS with optional fractional seconds.
+template<int NLookahead, typename Source>
+bool Tokenizer<NLookahead, Source>::getLocalTimeFast(Token &token) {
+   // HH:MM:SS.nnnnnnnnn, plus one to see what follows
+   constexpr std::size_t maxLength = 19;
+   char buf[maxLength];
+   std::size_t n = maxLength;
+   const char *p = lookahead(buf, n);
+
+   Time time;
+   if (n < 8 || !swar::parseTime(p, time)) {
+      return false;
+   }
+
+   std::size_t len = 8;
+   if (n > len && p[len] == '.') {
+      std::size_t fraction = getFractionFast(p + len, n - len, time);
+      if (fraction == 0) {
+         return false;
+      }
+      len += fraction;
+   }
+
+   // Leave lone times with offsets to getLocalTime() to report.
+   char c = n > len ? p[len] : '\0';
+   if (c == '+' || c == '-' || c == 'z' || c == 'Z') {
+      return false;
+   }
+
+   token.value = time;
+   consume(p, len);
+   return true;
+}
+
+// Parses ".n" to ".nnnnnnnnn" at p into time.nanosecond. Returns the number
+// of characters used, or 0 if there is no digit after the '.'.
+template<int NLookahead, typename Source>
+std::size_t Tokenizer<NLookahead, Source>::getFractionFast(const char *p,
+                                                           std::size_t n,
+                                                           Time &time)
+{
+   std::size_t len = 1;
+   int nanosecond = 0;
+   // We support nanoseconds precision (up to .999999999)
+   while (len < n && len <= 9 && test(p[len], Character::DecimalDigit)) {
+      nanosecond = nanosecond * 10 + (p[len] - '0');
+      ++len;
+   }
+   if (len == 1) {
+      return 0;
+   }
+   for (std::size_t digits = len - 1; digits < 9; ++digits) {
+      nanosecond *= 10;
+   }
+   time.nanosecond = nanosecond;
+   return len;
+}
+
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getNewlines() {
+   beginToken(Token::Kind::Newline);
 
    int c = in.peek();
    if (c == std::char_traits<char>::eof()) {
@@ -682,111 +1387,103 @@ void Tokenizer<NLookahead>::getNewlines() {
           && (c == '\n' || c == '\r'))
    {
       if (c == '\n') {
-         token.lexeme += expect('\n');
+         expect('\n');
       }
       else {
-         token.lexeme += expect('\r');
-         token.lexeme += expect('\n');
+         expect('\r');
+         expect('\n');
       }
       c = in.peek();
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getWhitespace() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::Whitespace;
-   token.lexeme += expect(Character::Whitespace);
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getWhitespace() {
+   beginToken(Token::Kind::Whitespace);
+   expect(Character::Whitespace);
 
    int c = in.peek();
-   while (c != std::char_traits<char>::eof() && isspace(c)) {
-      token.lexeme += expect(Character::Whitespace);
+   while (test(c, Character::Whitespace)) {
+      expect(Character::Whitespace);
       c = in.peek();
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getId() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::Id;
-   token.lexeme += expect(Character::Id);
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getId() {
+   beginToken(Token::Kind::Id);
+   expect(Character::Id);
 
    int c = in.peek();
-   while (c != std::char_traits<char>::eof()
-          && (isalnum(c) || c == '_' || c == '-'))
-   {
-      token.lexeme += expect(Character::Id);
+   while (test(c, Character::Id)) {
+      expect(Character::Id);
       c = in.peek();
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getChar() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::Char;
-   token.lexeme += expect(Character::Printable);
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getChar() {
+   beginToken(Token::Kind::Char);
+   expect(Character::Printable);
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getComment() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::Comment;
-   token.lexeme += expect('#');
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getComment() {
+   beginToken(Token::Kind::Comment);
+   expect('#');
 
+   skipPlainRun();
    int c = in.peek();
    while (c != std::char_traits<char>::eof() && c != '\r' && c != '\n') {
-      token.lexeme += expect(Character::Printable);
+      expect(Character::Printable);
+      skipPlainRun();
       c = in.peek();
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getBasicString() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::String;
-   token.lexeme += expect('"');
-   token.value = "";
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getBasicString() {
+   beginToken(Token::Kind::String);
+   expect('"');
+   beginValue();
 
    int c = in.peek();
+   bool empty = (c == '"');
    while (c != std::char_traits<char>::eof() && c != '"') {
       if (c == '\\') {
          getEscapeSequence();
       }
-      else {
-         token.lexeme += expect(Character::Printable);
-         std::get<std::string>(token.value) += token.lexeme.back();
+      else if (appendPlainRun() == 0) {
+         appendValue(expect(Character::Printable));
       }
       c = in.peek();
    }
-   token.lexeme += expect('"');
+   expect('"');
 
    // At this point, we've consumed two double quotes. If there were any
    // characters between the quotes, we're done. However, if it was an empty
    // string, we have to be sure that it was an empty string and not the
    // beginning of a multiline string.
 
-   if (token.lexeme.length() == 2 // 2 quotes and that's it
-       && in.peek() == '"')
-   { 
-      token.lexeme += expect('"');
+   if (empty && in.peek() == '"') {
+      expect('"');
       getMLBasicString();
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getMLBasicString() {
-   auto &token = buffer.back();
-
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getMLBasicString() {
    int c = in.peek();
    if (c == '\r') {
-      token.lexeme += expect('\r');
-      token.lexeme += expect('\n');
+      expect('\r');
+      expect('\n');
       c = in.peek();
    }
    else if (c == '\n') {
-      token.lexeme += expect('\n');
+      expect('\n');
       c = in.peek();
    }
+   beginValue();
 
    // A multiline basic string must end with at least 3 quote marks but can
    // end with as many as 5 (up to 2 adjacent quotes are allowed inside an ML
@@ -795,7 +1492,7 @@ void Tokenizer<NLookahead>::getMLBasicString() {
    while (c != std::char_traits<char>::eof() && numQuotes < 5) {
       if (c == '"') {
          ++numQuotes;
-         token.lexeme += expect('"');
+         expect('"');
       }
       else if (numQuotes >= 3) {
          break;
@@ -804,24 +1501,23 @@ void Tokenizer<NLookahead>::getMLBasicString() {
          while (numQuotes > 0) {
             // we've been racking up quotes, and we just found out they're
             // actually part of the string, so add them to the value
-            std::get<std::string>(token.value) += '"';
+            appendValue('"');
             --numQuotes;
          }
 
          if (c == '\\') {
             c = in.peek(1);
             if (c == '\r' || c == '\n') {
-               token.lexeme += expect('\\');
+               expect('\\');
+               markDecoded();
                trimWhitespace();
             }
             else {
                getEscapeSequence();
             }
          }
-         else {
-            token.lexeme += c;
-            std::get<std::string>(token.value) += c;
-            expect(c);
+         else if (appendPlainRun() == 0) {
+            appendValue(expect(static_cast<char>(c)));
          }
       }
 
@@ -833,26 +1529,24 @@ void Tokenizer<NLookahead>::getMLBasicString() {
    }
 
    while (numQuotes > 3) {
-      std::get<std::string>(token.value) += '"';
+      appendValue('"');
       --numQuotes;
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::trimWhitespace() {
-   auto &token = buffer.back();
-
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::trimWhitespace() {
    int c = in.peek();
    while (true) {
       if (c == '\r') {
-         token.lexeme += expect('\r');
-         token.lexeme += expect('\n');
+         expect('\r');
+         expect('\n');
       }
       else if (c == '\n') {
-         token.lexeme += expect('\n');
+         expect('\n');
       }
       else if (test(c, Character::Whitespace)) {
-         token.lexeme += expect(Character::Whitespace);
+         expect(Character::Whitespace);
       }
       else {
          break;
@@ -862,48 +1556,46 @@ void Tokenizer<NLookahead>::trimWhitespace() {
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getLiteralString() {
-   Token &token = buffer.emplace_back();
-   token.kind = Token::Kind::String;
-   token.lexeme += expect('\'');
-   token.value = "";
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getLiteralString() {
+   beginToken(Token::Kind::String);
+   expect('\'');
+   beginValue();
 
    int c = in.peek();
+   bool empty = (c == '\'');
    while (c != std::char_traits<char>::eof() && c != '\'') {
-      token.lexeme += expect(Character::Printable);
-      std::get<std::string>(token.value) += token.lexeme.back();
+      if (appendPlainRun() == 0) {
+         appendValue(expect(Character::Printable));
+      }
       c = in.peek();
    }
-   token.lexeme += expect('\'');
+   expect('\'');
 
    // At this point, we've consumed two single quotes. If there were any
    // characters between the quotes, we're done. However, if it was an empty
    // string, we have to be sure that it was an empty string and not the
    // beginning of a multiline string.
 
-   if (token.lexeme.length() == 2 // 2 quotes and that's it
-       && in.peek() == '\'')
-   { 
-      token.lexeme += expect('\'');
+   if (empty && in.peek() == '\'') {
+      expect('\'');
       getMLLiteralString();
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getMLLiteralString() {
-   auto &token = buffer.back();
-
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getMLLiteralString() {
    int c = in.peek();
    if (c == '\r') {
-      token.lexeme += expect('\r');
-      token.lexeme += expect('\n');
+      expect('\r');
+      expect('\n');
       c = in.peek();
    }
    else if (c == '\n') {
-      token.lexeme += expect('\n');
+      expect('\n');
       c = in.peek();
    }
+   beginValue();
 
    // A multiline literal string must end with at least 3 quote marks but can
    // end with as many as 5 (up to 2 adjacent quotes are allowed inside an ML
@@ -912,7 +1604,7 @@ void Tokenizer<NLookahead>::getMLLiteralString() {
    while (c != std::char_traits<char>::eof() && numQuotes < 5) {
       if (c == '\'') {
          ++numQuotes;
-         token.lexeme += expect('\'');
+         expect('\'');
       }
       else if (numQuotes >= 3) {
          break;
@@ -921,12 +1613,12 @@ void Tokenizer<NLookahead>::getMLLiteralString() {
          while (numQuotes > 0) {
             // we've been racking up quotes, and we just found out they're
             // actually part of the string, so add them to the value
-            std::get<std::string>(token.value) += '\'';
+            appendValue('\'');
             --numQuotes;
          }
-         token.lexeme += c;
-         std::get<std::string>(token.value) += c;
-         expect(c);
+         if (appendPlainRun() == 0) {
+            appendValue(expect(static_cast<char>(c)));
+         }
       }
 
       c = in.peek();
@@ -937,46 +1629,64 @@ void Tokenizer<NLookahead>::getMLLiteralString() {
    }
 
    while (numQuotes > 3) {
-      std::get<std::string>(token.value) += '\'';
+      appendValue('\'');
       --numQuotes;
    }
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::getEscapeSequence() {
-   auto &token = buffer.back();
-
-   token.lexeme += expect('\\');
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::getEscapeSequence() {
+   expect('\\');
    int c = in.peek();
    switch (c) {
    case 'b':
-      token.lexeme += expect('b');
-      std::get<std::string>(token.value) += '\b';
+      expect('b');
+      appendDecoded('\b');
       break;
    case 't':
-      token.lexeme += expect('t');
-      std::get<std::string>(token.value) += '\t';
+      expect('t');
+      appendDecoded('\t');
       break;
    case 'n':
-      token.lexeme += expect('n');
-      std::get<std::string>(token.value) += '\n';
+      expect('n');
+      appendDecoded('\n');
       break;
    case 'f':
-      token.lexeme += expect('f');
-      std::get<std::string>(token.value) += '\f';
+      expect('f');
+      appendDecoded('\f');
       break;
    case 'r':
-      token.lexeme += expect('r');
-      std::get<std::string>(token.value) += '\r';
+      expect('r');
+      appendDecoded('\r');
       break;
    case '"':
-      token.lexeme += expect('"');
-      std::get<std::string>(token.value) += '"';
+      expect('"');
+      appendDecoded('"');
       break;
    case '\\':
-      token.lexeme += expect('\\');
-      std::get<std::string>(token.value) += '\\';
+      expect('\\');
+      appendDecoded('\\');
       break;
+   case 'u':
+   case 'U':
+      {
+         int line = lineNum;
+         int col = colNum;
+         expect(static_cast<char>(c));
+         std::uint32_t code = 0;
+         for (int i = c == 'u' ? 4 : 8; i > 0; --i) {
+            code = code << 4 | utf8::hexValue(expect(Character::HexDigit));
+         }
+         if (!utf8::isScalarValue(code)) {
+            throw SyntaxError("Invalid Unicode scalar value", line, col);
+         }
+         char bytes[4];
+         std::size_t n = utf8::encode(code, bytes);
+         for (std::size_t i = 0; i < n; ++i) {
+            appendDecoded(bytes[i]);
+         }
+         break;
+      }
    case std::char_traits<char>::eof():
       throw SyntaxError("Unexpected EOF", lineNum, colNum);
    default:
@@ -984,8 +1694,8 @@ void Tokenizer<NLookahead>::getEscapeSequence() {
    }
 }
 
-template<int NLookahead>
-char Tokenizer<NLookahead>::expect(Character charClass) {
+template<int NLookahead, typename Source>
+char Tokenizer<NLookahead, Source>::expect(Character charClass) {
    int c = in.get();
    if (c == std::char_traits<char>::eof()) {
       throw SyntaxError("Unexpected EOF", lineNum, colNum);
@@ -995,12 +1705,15 @@ char Tokenizer<NLookahead>::expect(Character charClass) {
       throwUnexpectedCharacter(charClass);
    }
 
+   if constexpr (!contiguous) {
+      current->storage += static_cast<char>(c);
+   }
    ++colNum;
    return c;
 }
 
-template<int NLookahead>
-char Tokenizer<NLookahead>::expect(char c) {
+template<int NLookahead, typename Source>
+char Tokenizer<NLookahead, Source>::expect(char c) {
    int _c = in.get();
    if (_c == std::char_traits<char>::eof()) {
       throw SyntaxError("Unexpected EOF", lineNum, colNum);
@@ -1008,6 +1721,9 @@ char Tokenizer<NLookahead>::expect(char c) {
    if (_c != c) {
       throw SyntaxError("Unexpected character", lineNum, colNum);
    }
+   if constexpr (!contiguous) {
+      current->storage += c;
+   }
    if (c == '\n') {
       ++lineNum;
       colNum = 0;
@@ -1016,8 +1732,8 @@ char Tokenizer<NLookahead>::expect(char c) {
    return c;
 }
 
-template<int NLookahead>
-std::string Tokenizer<NLookahead>::expect(const std::string &s) {
+template<int NLookahead, typename Source>
+std::string Tokenizer<NLookahead, Source>::expect(const std::string &s) {
    int startLine = lineNum;
    int startCol = colNum;
 
@@ -1036,11 +1752,14 @@ std::string Tokenizer<NLookahead>::expect(const std::string &s) {
       ++colNum;
    }
 
+   if constexpr (!contiguous) {
+      current->storage += s;
+   }
    return s;
 }
 
-template<int NLookahead>
-void Tokenizer<NLookahead>::throwUnexpectedCharacter(
+template<int NLookahead, typename Source>
+void Tokenizer<NLookahead, Source>::throwUnexpectedCharacter(
                                Character expectedCharClass) const
 {
    switch (expectedCharClass) {
@@ -1066,32 +1785,9 @@ void Tokenizer<NLookahead>::throwUnexpectedCharacter(
                    + std::to_string(static_cast<int>(expectedCharClass)));
 }
 
-template<int NLookahead>
-bool Tokenizer<NLookahead>::test(int c, Character charClass) {
-   switch (charClass) {
-   case Character::Printable:
-      // This gives us any printable ASCII character, including spaces and tabs
-      // but excluding \r and \n
-      return c >= 32 && c <= 126;
-   case Character::DecimalDigit:
-      return isdigit(c);
-   case Character::DecimalDigitPlusMinus:
-      return isdigit(c) || c == '+' || c == '-';
-   case Character::BinaryDigit:
-      return c == '0' || c == '1';
-   case Character::OctalDigit:
-      return c >= '0' && c <= '7';
-   case Character::HexDigit:
-      return isdigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
-   case Character::Whitespace:
-      return isspace(c);
-   case Character::Id:
-      return isalnum(c) || c == '_' || c == '-';
-   default:
-      throw Exception("Unsupported character class "
-                      + std::to_string(static_cast<int>(charClass)));
-   }
-}
+Tokenizer(std::istream &) -> Tokenizer<>;
+Tokenizer(std::string_view) -> Tokenizer<1, BufferSource>;
+Tokenizer(const char *) -> Tokenizer<1, BufferSource>;
 
 } // namespace ccm::toml
 
@@ -1,7 +1,267 @@
 #include "toml.h"
 
-#include <iostream>
+#include "array-split.h"
+#include "buffer-source.h"
+#include "document-builder.h"
+#include "mapped-file.h"
+#include "parser.h"
+#include "tokenizer.h"
 
-void print() {
-   std::cout << "Hello world!\n";
-}
\ No newline at end of file
+#include <algorithm>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+template<typename Tokenizer>
+Document parseTokens(Tokenizer &tokenizer, const ParseOptions &options) {
+   DocumentBuilder builder(options.upstream, options.strings);
+   Parser<Tokenizer, DocumentBuilder> parser(tokenizer, builder);
+   parser.parse();
+   return builder.finish();
+}
+
+// True if the line starting at `pos` could be a [table] or [[array]]
+// header: it ends in ']', ignoring trailing whitespace. Elements of
+// multi-line arrays and lines in multi-line strings can look like this too,
+// which the parse that follows finds out.
+bool looksLikeHeader(string_view text, size_t pos) {
+   size_t end = min(text.find('\n', pos), text.size());
+   while (end > pos
+          && (text[end - 1] == ' ' || text[end - 1] == '\t'
+              || text[end - 1] == '\r'))
+   {
+      --end;
+   }
+   return end > pos + 1 && text[end - 1] == ']';
+}
+
+// Splits `text` into at most `parts` parts of at least minChunk bytes, each
+// but the first beginning at a line that starts with '['. Returns where each
+// part starts.
+vector<size_t> splitPoints(string_view text, size_t parts, size_t minChunk) {
+   vector<size_t> starts = { 0 };
+   parts = min(parts, text.size() / max<size_t>(minChunk, 1));
+   for (size_t i = 1; i < parts; ++i) {
+      size_t pos = max(text.size() / parts * i, starts.back() + minChunk);
+      while (pos < text.size()) {
+         pos = text.find("\n[", pos);
+         if (pos == string_view::npos || looksLikeHeader(text, pos + 1)) {
+            break;
+         }
+         pos += 2;
+      }
+      if (pos >= text.size() || text.size() - pos < minChunk) {
+         break;
+      }
+      starts.push_back(pos + 1);
+   }
+   return starts;
+}
+
+// Calls parsePart(i) for each i < count, at once: 0 on this thread and the
+// rest on threads of their own, or on this one if no more can be started.
+template<typename F>
+void runParts(size_t count, F &&parsePart) {
+   vector<thread> workers;
+   for (size_t i = 1; i < count; ++i) {
+      try {
+         workers.emplace_back(parsePart, i);
+      }
+      catch (const system_error &) {
+         parsePart(i);
+      }
+   }
+   parsePart(0);
+   for (thread &worker : workers) {
+      worker.join();
+   }
+}
+
+// Parses the parts of a document at once, each with a builder of its own,
+// and merges them into the first part's builder. A part may only fail to
+// parse because the split point before or after it wasn't really at a
+// header, or because the document is malformed; either way, parsing the
+// whole document again settles it.
+Document parseParts(string_view text, const vector<size_t> &starts,
+                    const ParseOptions &options)
+{
+   size_t count = starts.size();
+   vector<unique_ptr<DocumentBuilder>> builders;
+   builders.push_back(make_unique<DocumentBuilder>(options.upstream,
+                                                   options.strings));
+   for (size_t i = 1; i < count; ++i) {
+      builders.push_back(make_unique<DocumentBuilder>());
+   }
+
+   vector<exception_ptr> errors(count);
+   auto parsePart = [&](size_t i) {
+      size_t end = i + 1 < count ? starts[i + 1] : text.size();
+      try {
+         Tokenizer<0, BufferSource> tokenizer(
+            text.substr(starts[i], end - starts[i]));
+         Parser<Tokenizer<0, BufferSource>, DocumentBuilder>(
+            tokenizer, *builders[i]).parse();
+      }
+      catch (...) {
+         errors[i] = current_exception();
+      }
+   };
+
+   runParts(count, parsePart);
+
+   bool merged = none_of(errors.begin(), errors.end(),
+                         [](const exception_ptr &e) { return bool(e); });
+   for (size_t i = 1; merged && i < count; ++i) {
+      merged = builders[0]->merge(*builders[i]);
+   }
+   if (!merged) {
+      Tokenizer<0, BufferSource> tokenizer(text);
+      return parseTokens(tokenizer, options);
+   }
+   return builders[0]->finish();
+}
+
+// A DocumentBuilder that splits large arrays that are the values of keys at
+// commas between their elements, and parses the runs of elements on several
+// threads, in place of the Tokenizer it is built from. If a run fails to
+// parse, the Tokenizer reads the whole array itself after all, so that the
+// error is reported where it is.
+class ArraySplittingBuilder : public DocumentBuilder {
+public:
+   using BufferTokenizer = Tokenizer<0, BufferSource>;
+
+   ArraySplittingBuilder(BufferTokenizer &tokenizer, string_view text,
+                         unsigned threads, const ParseOptions &options)
+      : DocumentBuilder(options.upstream, options.strings),
+        tokenizer(tokenizer),
+        text(text),
+        threads(threads),
+        minChunk(options.minChunk),
+        splitter(text)
+      { }
+
+   void onArrayBegin();
+   void onArrayEnd() {
+      --nesting;
+      DocumentBuilder::onArrayEnd();
+   }
+   void onInlineTableBegin() {
+      ++nesting;
+      DocumentBuilder::onInlineTableBegin();
+   }
+   void onInlineTableEnd() {
+      --nesting;
+      DocumentBuilder::onInlineTableEnd();
+   }
+
+private:
+   BufferTokenizer &tokenizer;
+   string_view text;
+   unsigned threads;
+   size_t minChunk;
+   ArraySplitter splitter;
+
+   // How many arrays and inline tables are open
+   int nesting = 0;
+
+   // Builders of runs of elements, whose nodes the document is built from
+   vector<unique_ptr<DocumentBuilder>> runs;
+};
+
+void ArraySplittingBuilder::onArrayBegin() {
+   DocumentBuilder::onArrayBegin();
+   if (nesting++ > 0) {
+      return;
+   }
+
+   // The Tokenizer has just read the '['.
+   ArraySplit split;
+   ArraySplit::Position open{ tokenizer.position() - 1, tokenizer.line(),
+                              tokenizer.column() - 1 };
+   if (!splitter.split(open, threads, minChunk, split)) {
+      return;
+   }
+
+   size_t count = split.starts.size();
+   vector<unique_ptr<DocumentBuilder>> builders;
+   for (size_t i = 0; i < count; ++i) {
+      builders.push_back(make_unique<DocumentBuilder>());
+   }
+   vector<char> failed(count, false);
+   runParts(count, [&](size_t i) {
+      const ArraySplit::Position &start = split.starts[i];
+      size_t end = i + 1 < count ? split.starts[i + 1].offset
+                                 : split.close.offset;
+      try {
+         BufferTokenizer run(text.substr(0, end));
+         run.enterArray();
+         run.seek(start.offset, start.line, start.col);
+         builders[i]->beginElements();
+         Parser<BufferTokenizer, DocumentBuilder>(run, *builders[i])
+            .parseElements();
+      }
+      catch (...) {
+         failed[i] = true;
+      }
+   });
+   if (find(failed.begin(), failed.end(), true) != failed.end()) {
+      return;
+   }
+
+   appendElements(builders);
+   for (auto &builder : builders) {
+      runs.push_back(move(builder));
+   }
+   tokenizer.seek(split.close.offset, split.close.line, split.close.col);
+}
+
+Document parseBuffer(string_view text, const ParseOptions &options) {
+   unsigned threads = options.threads;
+   if (threads == 0) {
+      threads = max(thread::hardware_concurrency(), 1u);
+   }
+   vector<size_t> starts;
+   if (threads > 1) {
+      starts = splitPoints(text, threads, options.minChunk);
+   }
+   if (starts.size() > 1) {
+      return parseParts(text, starts, options);
+   }
+   Tokenizer<0, BufferSource> tokenizer(text);
+   if (threads > 1) {
+      ArraySplittingBuilder builder(tokenizer, text, threads, options);
+      Parser<Tokenizer<0, BufferSource>, ArraySplittingBuilder>(
+         tokenizer, builder).parse();
+      return builder.finish();
+   }
+   return parseTokens(tokenizer, options);
+}
+
+}
+
+Document parse(string_view text, const ParseOptions &options) {
+   return parseBuffer(text, options);
+}
+
+Document parse(istream &in, const ParseOptions &options) {
+   Tokenizer<0> tokenizer(in);
+   return parseTokens(tokenizer, options);
+}
+
+Document parseFile(const string &path, const ParseOptions &options) {
+   if (options.threads != 1) {
+      MappedFile file(path);
+      return parseBuffer(file.view(), options);
+   }
+   Tokenizer<0, MappedFileSource> tokenizer(path);
+   return parseTokens(tokenizer, options);
+}
+
+}
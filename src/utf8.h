@@ -0,0 +1,96 @@
+#ifndef CCM_TOML_UTF8_H
+#define CCM_TOML_UTF8_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ccm::toml::utf8 {
+
+// The code points that \uXXXX and \UXXXXXXXX escapes may stand for: all of
+// Unicode except the surrogates.
+inline bool isScalarValue(std::uint32_t c) {
+   return c <= 0x10FFFF && (c < 0xD800 || c > 0xDFFF);
+}
+
+// Encodes a scalar value into out, returning the number of bytes used.
+inline std::size_t encode(std::uint32_t c, char out[4]) {
+   if (c < 0x80) {
+      out[0] = static_cast<char>(c);
+      return 1;
+   }
+   if (c < 0x800) {
+      out[0] = static_cast<char>(0xC0 | c >> 6);
+      out[1] = static_cast<char>(0x80 | (c & 0x3F));
+      return 2;
+   }
+   if (c < 0x10000) {
+      out[0] = static_cast<char>(0xE0 | c >> 12);
+      out[1] = static_cast<char>(0x80 | (c >> 6 & 0x3F));
+      out[2] = static_cast<char>(0x80 | (c & 0x3F));
+      return 3;
+   }
+   out[0] = static_cast<char>(0xF0 | c >> 18);
+   out[1] = static_cast<char>(0x80 | (c >> 12 & 0x3F));
+   out[2] = static_cast<char>(0x80 | (c >> 6 & 0x3F));
+   out[3] = static_cast<char>(0x80 | (c & 0x3F));
+   return 4;
+}
+
+// Decodes the scalar value whose encoding starts at s[i] into c, moving i
+// past it. Returns false, leaving i as it was, if s[i] doesn't start a
+// well-formed sequence: a truncated or overlong one, or one encoding a
+// surrogate or a value past U+10FFFF.
+inline bool decode(std::string_view s, std::size_t &i, std::uint32_t &c) {
+   unsigned char lead = s[i];
+   std::size_t n;
+   std::uint32_t min;
+   if (lead < 0x80) {
+      c = lead;
+      ++i;
+      return true;
+   }
+   else if ((lead & 0xE0) == 0xC0) {
+      n = 2;
+      min = 0x80;
+      c = lead & 0x1F;
+   }
+   else if ((lead & 0xF0) == 0xE0) {
+      n = 3;
+      min = 0x800;
+      c = lead & 0x0F;
+   }
+   else if ((lead & 0xF8) == 0xF0) {
+      n = 4;
+      min = 0x10000;
+      c = lead & 0x07;
+   }
+   else {
+      return false;
+   }
+
+   if (s.size() - i < n) {
+      return false;
+   }
+   for (std::size_t j = 1; j < n; ++j) {
+      unsigned char next = s[i + j];
+      if ((next & 0xC0) != 0x80) {
+         return false;
+      }
+      c = c << 6 | (next & 0x3F);
+   }
+   if (c < min || !isScalarValue(c)) {
+      return false;
+   }
+   i += n;
+   return true;
+}
+
+// The value of a hex digit, which the caller has checked
+inline std::uint32_t hexValue(char c) {
+   return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+}
+
+#endif
@@ -0,0 +1,459 @@
+#include "writer.h"
+
+#include "document.h"
+#include "exception.h"
+#include "utf8.h"
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace ccm::toml {
+
+namespace {
+
+bool isBare(string_view key) {
+   if (key.empty()) {
+      return false;
+   }
+   for (char c : key) {
+      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '_' || c == '-'))
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+// True if c must be escaped in a basic string. The Tokenizer only reads
+// ASCII, so bytes >= 0x80 (UTF-8) are escaped too.
+bool needsEscape(unsigned char c) {
+   return c < 0x20 || c == '"' || c == '\\' || c >= 0x7F;
+}
+
+// An array is written as [[array]] sections if it only holds tables.
+bool isArrayOfTables(const Value &value) {
+   if (!value.is(Type::Array)) {
+      return false;
+   }
+   Array array = value.asArray();
+   if (array.empty()) {
+      return false;
+   }
+   for (Value element : array) {
+      if (!element.is(Type::Table)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+// Tables and arrays of tables are written as sections of their own; anything
+// else is written inline after its key.
+bool isSection(const Value &value) {
+   return value.is(Type::Table) || isArrayOfTables(value);
+}
+
+}
+
+Writer::Writer(string &out)
+   : out(&out)
+{
+}
+
+Writer::Writer(int fd)
+   : out(&buffer),
+     fd(fd)
+{
+   buffer.reserve(capacity);
+}
+
+Writer::~Writer() {
+   try {
+      flush();
+   }
+   catch (const Exception &) {
+   }
+}
+
+void Writer::document(const Document &doc) {
+   path.clear();
+   writeTable(doc.root(), false);
+}
+
+void Writer::header(const string_view *key, size_t count, bool array) {
+   if (frames.size() > 1 || afterKey) {
+      throw Exception("Writer: a header can't go inside a value");
+   }
+   if (started) {
+      *out += '\n';
+   }
+   started = true;
+   *out += array ? "[[" : "[";
+   writeKey(key, count);
+   *out += array ? "]]\n" : "]\n";
+   if (out->size() >= capacity) {
+      flush();
+   }
+}
+
+void Writer::key(const string_view *key, size_t count) {
+   Frame &frame = frames.back();
+   if (afterKey || frame.context == Context::Array) {
+      throw Exception("Writer: expected a value, not a key");
+   }
+   if (frame.context == Context::InlineTable) {
+      *out += frame.empty ? " " : ", ";
+   }
+   frame.empty = false;
+   writeKey(key, count);
+   *out += " = ";
+   afterKey = true;
+}
+
+void Writer::writeKey(const string_view *key, size_t count) {
+   for (size_t i = 0; i < count; ++i) {
+      if (i > 0) {
+         *out += '.';
+      }
+      writeSimpleKey(key[i]);
+   }
+}
+
+void Writer::writeSimpleKey(string_view key) {
+   if (isBare(key)) {
+      *out += key;
+   }
+   else {
+      writeString(key);
+   }
+}
+
+void Writer::value(string_view s) {
+   beginValue();
+   writeString(s);
+   endValue();
+}
+
+void Writer::value(int64_t i) {
+   beginValue();
+   char buf[24];
+   auto result = to_chars(buf, buf + sizeof buf, i);
+   out->append(buf, result.ptr);
+   endValue();
+}
+
+void Writer::value(double d) {
+   beginValue();
+   char buf[32];
+   auto result = to_chars(buf, buf + sizeof buf, d);
+   string_view text(buf, result.ptr - buf);
+   // TOML spells infinity "inf", as to_chars does, but a float needs a '.'
+   // or an exponent to be told apart from an integer.
+   out->append(text);
+   if (text.find_first_of(".eni") == string_view::npos) {
+      *out += ".0";
+   }
+   endValue();
+}
+
+void Writer::value(bool b) {
+   beginValue();
+   *out += b ? "true" : "false";
+   endValue();
+}
+
+void Writer::value(const DateTime &dateTime) {
+   beginValue();
+   writeDate(dateTime.date);
+   *out += 'T';
+   writeTime(dateTime.time);
+   if (dateTime.offset) {
+      const DateTime::Offset &offset = *dateTime.offset;
+      if (offset.hours == 0 && offset.minutes == 0 && !offset.negative) {
+         *out += 'Z';
+      }
+      else {
+         *out += offset.negative ? '-' : '+';
+         writeTwoDigits(offset.hours);
+         *out += ':';
+         writeTwoDigits(offset.minutes);
+      }
+   }
+   endValue();
+}
+
+void Writer::value(const Date &date) {
+   beginValue();
+   writeDate(date);
+   endValue();
+}
+
+void Writer::value(const Time &time) {
+   beginValue();
+   writeTime(time);
+   endValue();
+}
+
+void Writer::beginArray() {
+   beginValue();
+   *out += '[';
+   frames.push_back(Frame{ Context::Array, true });
+}
+
+void Writer::endArray() {
+   if (frames.back().context != Context::Array) {
+      throw Exception("Writer: endArray() without beginArray()");
+   }
+   frames.pop_back();
+   *out += ']';
+   endValue();
+}
+
+void Writer::beginInlineTable() {
+   beginValue();
+   *out += '{';
+   frames.push_back(Frame{ Context::InlineTable, true });
+}
+
+void Writer::endInlineTable() {
+   if (frames.back().context != Context::InlineTable || afterKey) {
+      throw Exception("Writer: endInlineTable() without beginInlineTable()");
+   }
+   *out += frames.back().empty ? "}" : " }";
+   frames.pop_back();
+   endValue();
+}
+
+void Writer::flush() {
+   if (fd < 0) {
+      return;
+   }
+   const char *p = buffer.data();
+   size_t left = buffer.size();
+   while (left > 0) {
+      ssize_t n = ::write(fd, p, left);
+      if (n < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         buffer.clear();
+         throw Exception(string("Writer: write() failed: ")
+                         + strerror(errno));
+      }
+      p += n;
+      left -= n;
+   }
+   buffer.clear();
+}
+
+// Writes a basic string, copying the runs between characters that need
+// escaping in one go. Characters past ASCII are written as \uXXXX or
+// \UXXXXXXXX. Throws Exception if the string isn't valid UTF-8.
+void Writer::writeString(string_view s) {
+   static constexpr char hex[] = "0123456789ABCDEF";
+
+   *out += '"';
+   size_t run = 0;
+   for (size_t i = 0; i < s.size(); ) {
+      unsigned char c = s[i];
+      if (!needsEscape(c)) {
+         ++i;
+         continue;
+      }
+      out->append(s.data() + run, i - run);
+      if (c >= 0x80) {
+         uint32_t code;
+         if (!utf8::decode(s, i, code)) {
+            throw Exception("Writer: a string isn't valid UTF-8");
+         }
+         int digits = code < 0x10000 ? 4 : 8;
+         *out += digits == 4 ? "\\u" : "\\U";
+         for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+            *out += hex[code >> shift & 0xF];
+         }
+         run = i;
+         continue;
+      }
+      run = ++i;
+      switch (c) {
+      case '\b':
+         *out += "\\b";
+         break;
+      case '\t':
+         *out += "\\t";
+         break;
+      case '\n':
+         *out += "\\n";
+         break;
+      case '\f':
+         *out += "\\f";
+         break;
+      case '\r':
+         *out += "\\r";
+         break;
+      case '"':
+         *out += "\\\"";
+         break;
+      case '\\':
+         *out += "\\\\";
+         break;
+      default:
+         *out += "\\u00";
+         *out += hex[c >> 4];
+         *out += hex[c & 0xF];
+      }
+   }
+   out->append(s.data() + run, s.size() - run);
+   *out += '"';
+}
+
+void Writer::writeDate(const Date &date) {
+   writeTwoDigits(date.year / 100);
+   writeTwoDigits(date.year % 100);
+   *out += '-';
+   writeTwoDigits(date.month);
+   *out += '-';
+   writeTwoDigits(date.day);
+}
+
+// Fractional seconds are written without trailing zeros.
+void Writer::writeTime(const Time &time) {
+   writeTwoDigits(time.hour);
+   *out += ':';
+   writeTwoDigits(time.minute);
+   *out += ':';
+   writeTwoDigits(time.second);
+   if (time.nanosecond != 0) {
+      char digits[10] = { '.' };
+      int n = time.nanosecond;
+      for (int i = 9; i > 0; --i) {
+         digits[i] = static_cast<char>('0' + n % 10);
+         n /= 10;
+      }
+      size_t length = 10;
+      while (digits[length - 1] == '0') {
+         --length;
+      }
+      out->append(digits, length);
+   }
+}
+
+void Writer::writeTwoDigits(int n) {
+   *out += static_cast<char>('0' + n / 10);
+   *out += static_cast<char>('0' + n % 10);
+}
+
+// Writes what goes before a value: nothing after a key, or a separator
+// between array elements.
+void Writer::beginValue() {
+   Frame &frame = frames.back();
+   if (frame.context == Context::Array) {
+      if (!frame.empty) {
+         *out += ", ";
+      }
+      frame.empty = false;
+   }
+   else if (!afterKey) {
+      throw Exception("Writer: expected a key before the value");
+   }
+   afterKey = false;
+}
+
+// Ends a top-level key/value pair's line once its value is complete.
+void Writer::endValue() {
+   if (frames.size() == 1) {
+      *out += '\n';
+      started = true;
+      if (out->size() >= capacity) {
+         flush();
+      }
+   }
+}
+
+// Writes the members of a table that go inline, after a [header] if one is
+// wanted, and then those that are sections of their own.
+void Writer::writeTable(const Table &table, bool header) {
+   if (header) {
+      this->header(path.data(), path.size(), false);
+   }
+
+   for (Table::Entry entry : table) {
+      if (!isSection(entry.value)) {
+         key(entry.key);
+         writeInline(entry.value);
+      }
+   }
+
+   for (Table::Entry entry : table) {
+      if (!isSection(entry.value)) {
+         continue;
+      }
+      path.push_back(entry.key);
+      if (entry.value.is(Type::Table)) {
+         // A table that only holds other tables needs no header of its own.
+         Table sub = entry.value.asTable();
+         bool needsHeader = sub.empty();
+         for (Table::Entry member : sub) {
+            needsHeader = needsHeader || !isSection(member.value);
+         }
+         writeTable(sub, needsHeader);
+      }
+      else {
+         for (Value element : entry.value.asArray()) {
+            this->header(path.data(), path.size(), true);
+            writeTable(element.asTable(), false);
+         }
+      }
+      path.pop_back();
+   }
+}
+
+void Writer::writeInline(const Value &value) {
+   switch (value.type()) {
+   case Type::Table:
+      beginInlineTable();
+      for (Table::Entry entry : value.asTable()) {
+         key(entry.key);
+         writeInline(entry.value);
+      }
+      endInlineTable();
+      break;
+   case Type::Array:
+      beginArray();
+      for (Value element : value.asArray()) {
+         writeInline(element);
+      }
+      endArray();
+      break;
+   case Type::String:
+      this->value(value.asString());
+      break;
+   case Type::Integer:
+      this->value(value.asInteger());
+      break;
+   case Type::Float:
+      this->value(value.asFloat());
+      break;
+   case Type::Boolean:
+      this->value(value.asBoolean());
+      break;
+   case Type::OffsetDateTime:
+   case Type::LocalDateTime:
+      this->value(value.asDateTime());
+      break;
+   case Type::LocalDate:
+      this->value(value.asDate());
+      break;
+   case Type::LocalTime:
+      this->value(value.asTime());
+      break;
+   }
+}
+
+}
@@ -0,0 +1,148 @@
+#ifndef CCM_TOML_WRITER_H
+#define CCM_TOML_WRITER_H
+
+#include "date-time.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace ccm::toml {
+
+class Document;
+class Table;
+class Value;
+
+// Writes TOML, either a whole Document or piece by piece:
+//
+//    std::string out;
+//    Writer writer(out);
+//    writer.key("title");
+//    writer.value("example");
+//    writer.tableHeader({ "servers", "alpha" });
+//    writer.key("ports");
+//    writer.beginArray();
+//    writer.value(8000);
+//    writer.endArray();
+//
+// writes
+//
+//    title = "example"
+//
+//    [servers.alpha]
+//    ports = [8000]
+//
+// Output goes to the end of a string the caller owns or, in blocks of
+// `capacity` bytes, to a file descriptor, which is not owned and is not
+// closed. Keys are quoted only if they need to be. Strings are written as
+// basic strings, copying runs of characters that need no escaping in one go.
+// Floats are written in the shortest form that reads back as the same
+// number. Once the output buffer has grown, writing allocates nothing.
+//
+// The Writer checks that calls come in a sensible order (a value after each
+// key, headers only at the top level) and throws Exception if not, but it
+// doesn't check that keys and tables are defined only once.
+class Writer {
+public:
+   static constexpr std::size_t capacity = 64 * 1024;
+
+   explicit Writer(std::string &out);
+   explicit Writer(int fd);
+   Writer(const Writer &) = delete;
+   Writer &operator=(const Writer &) = delete;
+
+   // Flushes, but can't report errors; call flush() first to see them.
+   ~Writer();
+
+   // Writes the whole document. Tables are written as [table] sections and
+   // arrays of tables as [[array]] sections, except inside arrays and
+   // other inline values, where they are written inline.
+   void document(const Document &doc);
+
+   // [a.b] and [[a.b]]. These may only come between key/value pairs.
+   void tableHeader(std::initializer_list<std::string_view> key)
+      { header(key.begin(), key.size(), false); }
+   void arrayTableHeader(std::initializer_list<std::string_view> key)
+      { header(key.begin(), key.size(), true); }
+
+   // Begins a key/value pair, or a dotted one. A value must follow.
+   void key(std::string_view key)
+      { this->key(&key, 1); }
+   void key(std::initializer_list<std::string_view> key)
+      { this->key(key.begin(), key.size()); }
+
+   void value(std::string_view s);
+   void value(const char *s)
+      { value(std::string_view(s)); }
+   void value(std::int64_t i);
+   template<typename I,
+            typename = std::enable_if_t<std::is_integral_v<I>
+                                        && !std::is_same_v<I, bool>>>
+   void value(I i)
+      { value(static_cast<std::int64_t>(i)); }
+   void value(double d);
+   void value(bool b);
+   void value(const DateTime &dateTime);
+   void value(const Date &date);
+   void value(const Time &time);
+
+   // A [ ... ] value, whose elements are written with value() and the other
+   // begin...() functions
+   void beginArray();
+   void endArray();
+
+   // A { ... } value, whose members are written with key() and a value
+   void beginInlineTable();
+   void endInlineTable();
+
+   // Writes what is buffered to the file descriptor, if there is one.
+   // Throws Exception if write() fails.
+   void flush();
+
+private:
+   enum class Context : std::uint8_t {
+      Document,
+      Array,
+      InlineTable
+   };
+
+   struct Frame {
+      Context context;
+      bool empty;
+   };
+
+   void header(const std::string_view *key, std::size_t count, bool array);
+   void key(const std::string_view *key, std::size_t count);
+   void writeKey(const std::string_view *key, std::size_t count);
+   void writeSimpleKey(std::string_view key);
+   void writeString(std::string_view s);
+   void writeDate(const Date &date);
+   void writeTime(const Time &time);
+   void writeTwoDigits(int n);
+   void beginValue();
+   void endValue();
+
+   void writeTable(const Table &table, bool header);
+   void writeInline(const Value &value);
+
+   std::string *out;
+   std::string buffer;
+   int fd = -1;
+
+   std::vector<Frame> frames = { Frame{ Context::Document, true } };
+   bool afterKey = false;
+
+   // Set once anything is written, so that headers after it get a blank line
+   bool started = false;
+
+   // The key of the table being written by document()
+   std::vector<std::string_view> path;
+};
+
+}
+
+#endif
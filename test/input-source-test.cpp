@@ -0,0 +1,90 @@
+#include "input-source-test.h"
+
+#include "buffer-source.h"
+#include "fd-source.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace ccm::toml;
+
+namespace {
+
+string display(int c) {
+   if (c == char_traits<char>::eof()) {
+      return "EOF";
+   }
+   string res;
+   res += c;
+   return res;
+}
+
+void gotExpected(int got, int expected) {
+   cout << "got " << display(got) << " | expected " << display(expected)
+        << '\n';
+}
+
+// Runs the same get/peek sequence against any source reading
+// "every good boy does fine".
+template<typename Source>
+void exercise(Source &in) {
+   gotExpected(in.get(), 'e');
+   gotExpected(in.peek(), 'v');
+   gotExpected(in.get(), 'v');
+   gotExpected(in.peek(2), 'y');
+   gotExpected(in.peek(1), 'r');
+   gotExpected(in.get(), 'e');
+
+   // consume until "fine"
+   for (int i = 0; i < 17; ++i) {
+      if (in.get() == char_traits<char>::eof()) {
+         cout << "UNEXPECTED EOF\n";
+         return;
+      }
+   }
+
+   gotExpected(in.peek(3), 'e');
+   gotExpected(in.peek(4), char_traits<char>::eof());
+   gotExpected(in.get(), 'f');
+
+   for (int i = 0; i < 3; ++i) {
+      in.get();
+   }
+
+   gotExpected(in.peek(), char_traits<char>::eof());
+   gotExpected(in.get(), char_traits<char>::eof());
+}
+
+} // namespace
+
+void InputSourceTest::run() {
+   testBufferSource();
+   testFdSource();
+}
+
+void InputSourceTest::testBufferSource() {
+   string s = "every good boy does fine";
+   BufferSource in(s);
+   exercise(in);
+}
+
+void InputSourceTest::testFdSource() {
+   FILE *file = tmpfile();
+   if (!file) {
+      cout << "TEST FAILED: could not create a temporary file\n";
+      return;
+   }
+
+   string s = "every good boy does fine";
+   fwrite(s.data(), 1, s.size(), file);
+   fflush(file);
+   rewind(file);
+
+   FdSource in(fileno(file));
+   exercise(in);
+   fclose(file);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef CCM_TOML_INPUT_SOURCE_TEST_H
+#define CCM_TOML_INPUT_SOURCE_TEST_H
+
+class InputSourceTest {
+public:
+   void run();
+
+private:
+   void testBufferSource();
+   void testFdSource();
+};
+
+#endif
\ No newline at end of file
@@ -107,4 +107,32 @@ void LookaheadIStreamTest::run() {
 
    c = in.get();
    gotExpected(c, char_traits<char>::eof());
+
+   testLongInput();
+}
+
+void LookaheadIStreamTest::testLongInput() {
+   // Long enough to wrap the ring buffer several times
+   string s;
+   for (int i = 0; i < 200000; ++i) {
+      s += static_cast<char>('a' + i % 26);
+   }
+
+   istringstream iss(s);
+   LookaheadIStream in(iss);
+
+   size_t mismatches = 0;
+   for (size_t i = 0; i < s.size(); ++i) {
+      if (i + 3 < s.size() && in.peek(3) != s[i + 3]) {
+         ++mismatches;
+      }
+      if (in.get() != s[i]) {
+         ++mismatches;
+      }
+   }
+
+   cout << "got " << mismatches << " mismatches | expected 0 mismatches\n";
+
+   int c = in.peek();
+   gotExpected(c, char_traits<char>::eof());
 }
\ No newline at end of file
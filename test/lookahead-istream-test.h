@@ -4,6 +4,9 @@
 class LookaheadIStreamTest {
 public:
    void run();
+
+private:
+   void testLongInput();
 };
 
 #endif
\ No newline at end of file
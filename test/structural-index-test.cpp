@@ -0,0 +1,72 @@
+#include "structural-index-test.h"
+
+#include "structural-index.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace ccm::toml;
+
+namespace {
+
+bool isStructural(char ch) {
+   unsigned char c = ch;
+   return c < 0x20 || c >= 0x7f || string_view("\"'\\#[]{}=,.").find(ch)
+                                   != string_view::npos;
+}
+
+// Compares next() against a naive scan, walking forwards through the input
+// as the Tokenizer would.
+size_t countMismatches(const string &input, StructuralIndex::Impl impl) {
+   StructuralIndex index;
+   index.reset(input, impl);
+
+   size_t mismatches = 0;
+   for (size_t pos = 0; pos < input.size(); ++pos) {
+      size_t naive = pos;
+      while (naive < input.size() && !isStructural(input[naive])) {
+         ++naive;
+      }
+      if (index.next(pos) != naive) {
+         ++mismatches;
+      }
+   }
+   if (index.next(input.size()) != input.size()) {
+      ++mismatches;
+   }
+   return mismatches;
+}
+
+} // namespace
+
+void StructuralIndexTest::run() {
+   mt19937 rng(42);
+   string alphabet = "abc xyz019\"'\\#[]{}=,.\r\n\t\x7f\xc3\xa9";
+
+   for (size_t size : { 0, 1, 63, 64, 65, 1000, 200000 }) {
+      string input;
+      for (size_t i = 0; i < size; ++i) {
+         // Mostly plain text with the occasional special character, so that
+         // runs cross 64-byte words and index windows.
+         if (rng() % 50 == 0) {
+            input += alphabet[rng() % alphabet.size()];
+         }
+         else {
+            input += static_cast<char>('a' + rng() % 26);
+         }
+      }
+
+      for (auto impl : { StructuralIndex::Impl::Scalar,
+                         StructuralIndex::Impl::SSE2,
+                         StructuralIndex::Impl::AVX2 })
+      {
+         if (!StructuralIndex::supports(impl)) {
+            continue;
+         }
+         cout << "got " << countMismatches(input, impl) << " mismatches | "
+              << "expected 0 mismatches\n";
+      }
+   }
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef CCM_TOML_STRUCTURAL_INDEX_TEST_H
+#define CCM_TOML_STRUCTURAL_INDEX_TEST_H
+
+class StructuralIndexTest {
+public:
+   void run();
+};
+
+#endif
\ No newline at end of file
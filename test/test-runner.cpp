@@ -1,9 +1,13 @@
 #include "toml-test.h"
 #include "tokenizer-test.h"
 #include "lookahead-istream-test.h"
+#include "input-source-test.h"
+#include "structural-index-test.h"
 
 int main() {
    LookaheadIStreamTest{}.run();
+   InputSourceTest{}.run();
+   StructuralIndexTest{}.run();
    TomlTest{}.run();
    TokenizerTest{}.run();
 }
\ No newline at end of file
@@ -1,11 +1,20 @@
 #include "tokenizer-test.h"
 
+#include "decode.h"
+#include "fd-source.h"
+#include "mapped-file.h"
 #include "tokenizer.h"
 
+#include <charconv>
+#include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <random>
 #include <sstream>
 
+#include <unistd.h>
+
 using namespace std;
 using namespace ccm::toml;
 
@@ -40,7 +49,7 @@ ostream & operator<<(ostream &out, const Token &token) {
       out << "Boolean, " << (get<bool>(token.value) ? "true" : "false");
       break;
    case Token::Kind::String:
-      out << "String, " << get<string>(token.value);
+      out << "String, " << get<string_view>(token.value);
       break;
    case Token::Kind::OffsetDateTime:
       {
@@ -108,6 +117,9 @@ ostream & operator<<(ostream &out, const Token &token) {
    case Token::Kind::ArrayTableClose:
       out << "ArrayTableClose";
       break;
+   case Token::Kind::Skimmed:
+      out << "Skimmed, " << token.lexeme;
+      break;
    }
 
    return out << ">";
@@ -118,6 +130,30 @@ void logSyntaxError(const SyntaxError &ex) {
         << ": " << ex.what() << '\n';
 }
 
+template<typename T>
+string tokenize(T &tokenizer) {
+   ostringstream out;
+   while (tokenizer.more()) {
+      Token t = tokenizer.next();
+      out << t << ' ' << t.lexeme << '\n';
+   }
+   return out.str();
+}
+
+// Like tokenize(), but decodes deferred tokens before printing them.
+template<typename T>
+string tokenizeLazily(T &tokenizer) {
+   ostringstream out;
+   string buf;
+   tokenizer.lazy(true);
+   while (tokenizer.more()) {
+      Token t = tokenizer.next();
+      t.value = decodeValue(t, buf);
+      out << t << ' ' << t.lexeme << '\n';
+   }
+   return out.str();
+}
+
 } // namespace
 
 void TokenizerTest::run() {
@@ -259,7 +295,12 @@ color = "gray"
       "x = -non",
       "x = ture",
       "x = flase",
-      "x = \"uh oh...\n\""
+      "x = \"uh oh...\n\"",
+      "x =\v1",
+      "x = 1\f",
+      "x = 1e400",
+      "x = 0x8000000000000000",
+      "x = 99999999999999999999"
    };
 
    for (const string &s : linesThatShouldFail) {
@@ -276,8 +317,26 @@ color = "gray"
       }
    }
 
+   try {
+      // Trailing whitespace must not swallow the newline after it
+      istringstream iss2("x = 1 \t\ny = 2");
+      Tokenizer tokenizer(iss2);
+      while (tokenizer.more()) {
+         tokenizer.next();
+      }
+      cout << "TEST PASSED (whitespace before newline)\n";
+   }
+   catch (const SyntaxError &ex) {
+      cout << "TEST FAILED: " << ex.what() << '\n';
+   }
+
    testCommas();
    testTables();
+   testSources();
+   testViews();
+   testNumbers();
+   testDateTimes();
+   testLazy();
 }
 
 void TokenizerTest::testCommas() {
@@ -368,4 +427,357 @@ type.name = "pug"
    catch (const SyntaxError &ex) {
       logSyntaxError(ex);
    }
-}
\ No newline at end of file
+}
+
+void TokenizerTest::testSources() {
+   string doc = R"(
+title = "TOML \"Example\""  # comment
+[owner]
+dob = 1979-05-27T07:32:00-08:00
+ports = [ 8000, 8001, 8002 ]
+temp = { cpu = 79.5, case = 72.0 }
+)";
+
+   // Long enough to span several StructuralIndex windows
+   string filler;
+   for (int i = 0; i < 20000; ++i) {
+      filler += "lorem ipsum. ";
+   }
+   doc += "# " + filler + "\n";
+   doc += "basic = \"" + filler + "\\\" " + filler + "\"\n";
+   doc += "literal = '" + filler + "'\n";
+   doc += "ml = \"\"\"\n" + filler + "\n\"\" " + filler + "\"\"\"\"\n";
+
+   istringstream iss(doc);
+   Tokenizer streamTokenizer(iss);
+   string expected = tokenize(streamTokenizer);
+
+   Tokenizer bufferTokenizer{string_view(doc)};
+   if (tokenize(bufferTokenizer) == expected) {
+      cout << "TEST PASSED (BufferSource matches istream)\n";
+   }
+   else {
+      cout << "TEST FAILED: BufferSource differs from istream\n";
+   }
+
+   Tokenizer literalTokenizer("x = 1");
+   Tokenizer viewTokenizer{string_view("x = 1")};
+   if (tokenize(literalTokenizer) == tokenize(viewTokenizer)) {
+      cout << "TEST PASSED (a string literal is read as a BufferSource)\n";
+   }
+   else {
+      cout << "TEST FAILED: a string literal is read differently\n";
+   }
+
+   istringstream again(doc);
+   streamTokenizer.reset(again);
+   if (tokenize(streamTokenizer) == expected) {
+      cout << "TEST PASSED (reset onto another istream)\n";
+   }
+   else {
+      cout << "TEST FAILED: reset onto another istream differs\n";
+   }
+
+   FILE *file = tmpfile();
+   fwrite(doc.data(), 1, doc.size(), file);
+   fflush(file);
+   rewind(file);
+   Tokenizer<1, FdSource> fdTokenizer(fileno(file));
+   if (tokenize(fdTokenizer) == expected) {
+      cout << "TEST PASSED (FdSource matches istream)\n";
+   }
+   else {
+      cout << "TEST FAILED: FdSource differs from istream\n";
+   }
+   fclose(file);
+
+   char path[] = "/tmp/tokenizer-test-XXXXXX";
+   int fd = mkstemp(path);
+   if (fd < 0
+       || write(fd, doc.data(), doc.size()) != static_cast<ssize_t>(doc.size()))
+   {
+      cout << "TEST FAILED: could not write " << path << '\n';
+      return;
+   }
+   close(fd);
+   Tokenizer<1, MappedFileSource> mappedTokenizer(path);
+   if (tokenize(mappedTokenizer) == expected) {
+      cout << "TEST PASSED (MappedFileSource matches istream)\n";
+   }
+   else {
+      cout << "TEST FAILED: MappedFileSource differs from istream\n";
+   }
+   unlink(path);
+}
+
+void TokenizerTest::testViews() {
+   string doc = "plain = 'abc'\nescaped = \"a\\tb\"\n";
+   auto inDoc = [&](string_view v) {
+      return v.data() >= doc.data()
+             && v.data() + v.size() <= doc.data() + doc.size();
+   };
+
+   Tokenizer tokenizer{string_view(doc)};
+   vector<Token> tokens;
+   while (tokenizer.more()) {
+      tokens.push_back(tokenizer.next());
+   }
+
+   const Token &plain = tokens[4];
+   const Token &escaped = tokens[10];
+   if (inDoc(plain.lexeme) && inDoc(get<string_view>(plain.value))
+       && get<string_view>(plain.value) == "abc")
+   {
+      cout << "TEST PASSED (unescaped string views the input)\n";
+   }
+   else {
+      cout << "TEST FAILED: unescaped string does not view the input\n";
+   }
+   if (inDoc(escaped.lexeme) && !inDoc(get<string_view>(escaped.value))
+       && get<string_view>(escaped.value) == "a\tb")
+   {
+      cout << "TEST PASSED (escaped string is decoded)\n";
+   }
+   else {
+      cout << "TEST FAILED: escaped string was not decoded\n";
+   }
+
+   // Tokens from a stream own their characters and must survive copying
+   // after the tokenizer is gone.
+   vector<Token> copies;
+   {
+      istringstream iss(doc);
+      Tokenizer streamTokenizer(iss);
+      while (streamTokenizer.more()) {
+         copies.push_back(streamTokenizer.next());
+      }
+   }
+   copies.shrink_to_fit();
+   if (copies.size() == tokens.size() && copies[10].lexeme == "\"a\\tb\""
+       && get<string_view>(copies[10].value) == "a\tb")
+   {
+      cout << "TEST PASSED (stream tokens own their storage)\n";
+   }
+   else {
+      cout << "TEST FAILED: stream tokens lost their storage\n";
+   }
+}
+
+void TokenizerTest::testNumbers() {
+   istringstream iss(R"(
+a = -0
+b = -0.5
+c = 0x0e
+d = 0x7FFFFFFFFFFFFFFF
+e = 12345678901234567890.5
+f = 0.1e-5
+g = 1_000.000_1
+h = 2.2250738585072014e-308
+)");
+
+   auto precision = cout.precision(17);
+   try {
+      Tokenizer tokenizer(iss);
+      while (tokenizer.more()) {
+         const Token &t = tokenizer.next();
+         if (t.kind == Token::Kind::Integer || t.kind == Token::Kind::Float) {
+            cout << t << '\n';
+         }
+      }
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+   cout.precision(precision);
+
+   // Floats must round exactly like std::from_chars, whichever path the
+   // tokenizer takes.
+   mt19937_64 rng(7);
+   int mismatches = 0;
+   for (int i = 0; i < 10000; ++i) {
+      string num = to_string(rng() % 100000000000000000);
+      num.insert(rng() % (num.size() + 1), ".");
+      if (num.back() == '.') {
+         num += '0';
+      }
+      if (num[0] == '.') {
+         num = '0' + num;
+      }
+      if (rng() % 2) {
+         num += "e" + to_string(static_cast<int>(rng() % 80) - 40);
+      }
+
+      double expected = 0;
+      from_chars(num.data(), num.data() + num.size(), expected);
+
+      string doc = "x = " + num;
+      Tokenizer tokenizer{string_view(doc)};
+      double got = 1;
+      while (tokenizer.more()) {
+         const Token &t = tokenizer.next();
+         if (t.kind == Token::Kind::Float) {
+            got = get<double>(t.value);
+         }
+      }
+      if (memcmp(&got, &expected, sizeof(double)) != 0) {
+         ++mismatches;
+      }
+   }
+   cout << "got " << mismatches << " float mismatches | expected 0\n";
+}
+
+void TokenizerTest::testDateTimes() {
+   string doc = R"(
+a = 1979-05-27
+b = 1979-05-27T07:32:00
+c = 1979-05-27t07:32:00z
+d = 1979-05-27 07:32:00.5
+e = 1979-05-27T00:32:00.999999-07:00
+f = 1979-05-27T00:32:00.1234567891
+g = 07:32:00
+h = 00:32:00.000001
+i = [1979-05-27,07:32:00,1979-05-27T07:32:00Z]
+j = 1979-05-27 # not followed by a time
+)";
+
+   try {
+      istringstream iss(doc);
+      Tokenizer streamed(iss);
+      Tokenizer buffered{string_view(doc)};
+      string expected = tokenize(streamed);
+      string got = tokenize(buffered);
+      cout << expected;
+      if (got == expected) {
+         cout << "TEST PASSED (buffered date-times match streamed)\n";
+      }
+      else {
+         cout << "TEST FAILED: buffered date-times differ:\n" << got;
+      }
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   // Malformed date-times are reported by the character-at-a-time path, at
+   // the same position whichever source is used.
+   vector<string> linesThatShouldFail = {
+      "a = 1979-05-2",
+      "a = 1979-5-27",
+      "a = 1979-05-27T07:32",
+      "a = 1979-05-27T07:32:00.",
+      "a = 1979-05-27T07:32:00+07",
+      "a = 1979-05-27T07:32:00+0700",
+      "a = 07:32:00Z",
+      "a = 07:32:00.5-07:00",
+   };
+
+   for (const string &s : linesThatShouldFail) {
+      string streamedError, bufferedError;
+      try {
+         istringstream iss(s);
+         Tokenizer tokenizer(iss);
+         tokenize(tokenizer);
+      }
+      catch (const SyntaxError &ex) {
+         streamedError = to_string(ex.col) + ": " + ex.what();
+      }
+      try {
+         Tokenizer tokenizer{string_view(s)};
+         tokenize(tokenizer);
+      }
+      catch (const SyntaxError &ex) {
+         bufferedError = to_string(ex.col) + ": " + ex.what();
+      }
+
+      if (streamedError.empty()) {
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      else if (bufferedError != streamedError) {
+         cout << "TEST FAILED: got " << bufferedError << " | expected "
+              << streamedError << '\n';
+      }
+      else {
+         cout << "TEST PASSED (got SyntaxError at " << streamedError << ")\n";
+      }
+   }
+}
+
+void TokenizerTest::testLazy() {
+   string doc = R"(
+a = "tab\there \"quoted\" \\"
+b = """
+one \
+    two\nthree"""""
+c = 'literal \n'
+d = [-9223372036854775808, 0x7FFFFFFFFFFFFFFF, 0o17, 0b1_01, +1_000, 0_10, -0_10]
+e = [-0.5, 1e-3, 6.626e-34, 224_617.445_991_228, 12345678901234567890.5]
+f = -inf
+g = 1979-05-27T07:32:00Z
+h = "\u00E9 \U0001F600 \u0001"
+)";
+
+   auto precision = cout.precision(17);
+   try {
+      istringstream iss(doc);
+      Tokenizer eager(iss);
+      string expected = tokenize(eager);
+
+      Tokenizer buffered{string_view(doc)};
+      string got = tokenizeLazily(buffered);
+      if (got == expected) {
+         cout << "TEST PASSED (buffered lazy tokens decode the same)\n";
+      }
+      else {
+         cout << "TEST FAILED: got\n" << got << "expected\n" << expected;
+      }
+
+      istringstream iss2(doc);
+      Tokenizer streamed(iss2);
+      got = tokenizeLazily(streamed);
+      if (got == expected) {
+         cout << "TEST PASSED (streamed lazy tokens decode the same)\n";
+      }
+      else {
+         cout << "TEST FAILED: got\n" << got << "expected\n" << expected;
+      }
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+   cout.precision(precision);
+
+   // Unescaped strings need no decoding, so they aren't deferred.
+   {
+      Tokenizer tokenizer{string_view("a = 'x'")};
+      tokenizer.lazy(true);
+      Token t;
+      while (tokenizer.more()) {
+         t = tokenizer.next();
+      }
+      cout << "got " << t.deferred << " | expected 0\n";
+   }
+
+   // Numbers that are out of range are only found when they are decoded.
+   vector<string> valuesThatShouldFail = {
+      "x = 9223372036854775808",
+      "x = -9223372036854775809",
+      "x = 0x8000000000000000",
+      "x = 1e400"
+   };
+
+   for (const string &s : valuesThatShouldFail) {
+      try {
+         Tokenizer tokenizer{string_view(s)};
+         tokenizer.lazy(true);
+         string buf;
+         while (tokenizer.more()) {
+            decodeValue(tokenizer.next(), buf);
+         }
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      catch (const SyntaxError &ex) {
+         cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+              << ex.col << ": " << ex.what() << ")\n";
+      }
+   }
+}
@@ -8,6 +8,11 @@ public:
 private:
    void testCommas();
    void testTables();
+   void testSources();
+   void testViews();
+   void testNumbers();
+   void testDateTimes();
+   void testLazy();
 };
 
 #endif
\ No newline at end of file
@@ -2,6 +2,1476 @@
 
 #include "toml.h"
 
+#include "array-split.h"
+#include "document-builder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace ccm::toml;
+
+namespace {
+
+const char *example = R"(# This is a TOML document
+
+title = "TOML Example"
+
+[owner]
+name = "Tom Preston-Werner"
+dob = 1979-05-27T07:32:00-08:00
+
+[database]
+enabled = true
+ports = [ 8000, 8001, 8002 ]
+data = [ ["delta", "phi"], [3.14] ]
+temp_targets = { cpu = 79.5, case = 72.0 }
+
+[servers]
+
+[servers.alpha]
+ip = "10.0.0.1"
+role = "frontend"
+
+[servers.beta]
+ip = "10.0.0.2"
+role = "backend"
+
+[[products]]
+name = "Hammer"
+sku = 738594937
+
+[[products]]  # empty table within the array
+
+[[products]]
+name = "Nail"
+sku = 284758393
+color = "gray"
+
+[fruit]
+apple.color = "red"
+apple.taste.sweet = true
+
+[fruit.apple.texture]
+smooth = true
+
+[times]
+date = 1979-05-27
+time = 07:32:00.5
+local = 1979-05-27T07:32:00
+"quoted key" = 'literal \string'
+)";
+
+void print(ostream &out, Value value, int indent);
+
+void printTable(ostream &out, Table table, int indent) {
+   out << "{\n";
+   for (Table::Entry entry : table) {
+      out << string(indent + 2, ' ') << '"' << entry.key << "\" = ";
+      print(out, entry.value, indent + 2);
+      out << '\n';
+   }
+   out << string(indent, ' ') << '}';
+}
+
+void print(ostream &out, Value value, int indent) {
+   char fill = out.fill();
+   out << setfill('0');
+   switch (value.type()) {
+   case Type::Table:
+      printTable(out, value.asTable(), indent);
+      break;
+   case Type::Array:
+      {
+         out << '[';
+         const char *sep = " ";
+         for (Value element : value.asArray()) {
+            out << sep;
+            print(out, element, indent);
+            sep = ", ";
+         }
+         out << " ]";
+         break;
+      }
+   case Type::String:
+      out << '"' << value.asString() << '"';
+      break;
+   case Type::Integer:
+      out << value.asInteger();
+      break;
+   case Type::Float:
+      out << value.asFloat();
+      break;
+   case Type::Boolean:
+      out << (value.asBoolean() ? "true" : "false");
+      break;
+   case Type::OffsetDateTime:
+   case Type::LocalDateTime:
+      {
+         DateTime dt = value.asDateTime();
+         out << setw(4) << dt.date.year << '-' << setw(2) << dt.date.month
+             << '-' << setw(2) << dt.date.day << 'T'
+             << setw(2) << dt.time.hour << ':' << setw(2) << dt.time.minute
+             << ':' << setw(2) << dt.time.second << '.'
+             << setw(9) << dt.time.nanosecond;
+         if (dt.offset) {
+            out << (dt.offset->negative ? '-' : '+')
+                << setw(2) << dt.offset->hours << ':'
+                << setw(2) << dt.offset->minutes;
+         }
+         break;
+      }
+   case Type::LocalDate:
+      {
+         Date date = value.asDate();
+         out << setw(4) << date.year << '-' << setw(2) << date.month << '-'
+             << setw(2) << date.day;
+         break;
+      }
+   case Type::LocalTime:
+      {
+         Time time = value.asTime();
+         out << setw(2) << time.hour << ':' << setw(2) << time.minute << ':'
+             << setw(2) << time.second << '.' << setw(9) << time.nanosecond;
+         break;
+      }
+   }
+   out << setfill(fill);
+}
+
+string print(const Document &doc) {
+   ostringstream out;
+   printTable(out, doc.root(), 0);
+   return out.str();
+}
+
+void logSyntaxError(const SyntaxError &ex) {
+   cerr << "Syntax error at Line " << ex.line << " Character " << ex.col
+        << ": " << ex.what() << '\n';
+}
+
+// Counts the memory handed out to a Document's arena.
+class CountingResource : public pmr::memory_resource {
+public:
+   size_t allocated = 0;
+   size_t deallocated = 0;
+   int allocations = 0;
+   int deallocations = 0;
+
+private:
+   void *do_allocate(size_t bytes, size_t alignment) override {
+      allocated += bytes;
+      ++allocations;
+      return pmr::new_delete_resource()->allocate(bytes, alignment);
+   }
+
+   void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+      deallocated += bytes;
+      ++deallocations;
+      pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+   }
+
+   bool do_is_equal(const memory_resource &other) const noexcept override {
+      return this == &other;
+   }
+};
+
+string join(const DottedKey &key) {
+   string joined;
+   for (const KeySegment &segment : key) {
+      if (!joined.empty()) {
+         joined += '.';
+      }
+      joined += segment.name;
+   }
+   return joined;
+}
+
+// Writes each parser event on a line of its own.
+class RecordingHandler {
+public:
+   ostringstream out;
+
+   void onTableHeader(const DottedKey &key)
+      { out << "table " << join(key) << '\n'; }
+   void onArrayTableHeader(const DottedKey &key)
+      { out << "array table " << join(key) << '\n'; }
+   void onKey(const DottedKey &key)
+      { out << "key " << join(key) << '\n'; }
+   void onValue(string_view s)
+      { out << "string " << s << '\n'; }
+   void onValue(int64_t value)
+      { out << "integer " << value << '\n'; }
+   void onValue(double value)
+      { out << "float " << value << '\n'; }
+   void onValue(bool value)
+      { out << "boolean " << value << '\n'; }
+   void onValue(const DateTime &)
+      { out << "date-time\n"; }
+   void onValue(const Date &)
+      { out << "date\n"; }
+   void onValue(const Time &)
+      { out << "time\n"; }
+   void onArrayBegin()
+      { out << "[\n"; }
+   void onArrayEnd()
+      { out << "]\n"; }
+   void onInlineTableBegin()
+      { out << "{\n"; }
+   void onInlineTableEnd()
+      { out << "}\n"; }
+};
+
+struct Owner {
+   string name;
+   DateTime dob;
+};
+
+struct Temperatures {
+   double cpu = 0;
+   float gpu = 0;
+};
+
+struct Database {
+   bool enabled = false;
+   vector<uint16_t> ports;
+   Temperatures temp_targets;
+};
+
+struct Server {
+   string ip;
+   string role;
+};
+
+struct Servers {
+   Server alpha;
+   optional<Server> beta;
+   optional<Server> gamma;
+};
+
+struct Product {
+   string name;
+   int64_t sku = 0;
+   optional<string> color;
+};
+
+struct Times {
+   Date date;
+   Time time;
+   DateTime local;
+   string quoted;
+};
+
+struct Example {
+   string title;
+   Owner owner;
+   Database database;
+   Servers servers;
+   vector<Product> products;
+   Times times;
+};
+
+} // namespace
+
+template<>
+struct ccm::toml::Fields<Owner> {
+   static constexpr auto list = fields(field("name", &Owner::name),
+                                       field("dob", &Owner::dob));
+};
+
+template<>
+struct ccm::toml::Fields<Temperatures> {
+   static constexpr auto list = fields(field("cpu", &Temperatures::cpu),
+                                       field("case", &Temperatures::gpu));
+};
+
+template<>
+struct ccm::toml::Fields<Database> {
+   static constexpr auto list = fields(
+      field("enabled", &Database::enabled),
+      field("ports", &Database::ports),
+      field("temp_targets", &Database::temp_targets));
+};
+
+template<>
+struct ccm::toml::Fields<Server> {
+   static constexpr auto list = fields(field("ip", &Server::ip),
+                                       field("role", &Server::role));
+};
+
+template<>
+struct ccm::toml::Fields<Servers> {
+   static constexpr auto list = fields(field("alpha", &Servers::alpha),
+                                       field("beta", &Servers::beta),
+                                       field("gamma", &Servers::gamma));
+};
+
+template<>
+struct ccm::toml::Fields<Product> {
+   static constexpr auto list = fields(field("name", &Product::name),
+                                       field("sku", &Product::sku),
+                                       field("color", &Product::color));
+};
+
+template<>
+struct ccm::toml::Fields<Times> {
+   static constexpr auto list = fields(field("date", &Times::date),
+                                       field("time", &Times::time),
+                                       field("local", &Times::local),
+                                       field("quoted key", &Times::quoted));
+};
+
+template<>
+struct ccm::toml::Fields<Example> {
+   static constexpr auto list = fields(
+      field("title", &Example::title),
+      field("owner", &Example::owner),
+      field("database", &Example::database),
+      field("servers", &Example::servers),
+      field("products", &Example::products),
+      field("times", &Example::times));
+};
+
 void TomlTest::run() {
-   print();
-}
\ No newline at end of file
+   testParse();
+   testLookups();
+   testValid();
+   testInvalid();
+   testSources();
+   testLargeTables();
+   testArena();
+   testInterning();
+   testEvents();
+   testReader();
+   testQueries();
+   testBinding();
+   testWriter();
+   testParallel();
+   testParseFiles();
+   testSnapshots();
+   testIncremental();
+}
+
+void TomlTest::testParse() {
+   try {
+      Document doc = parse(example);
+      cout << print(doc) << '\n';
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+}
+
+void TomlTest::testLookups() {
+   try {
+      Document doc = parse(example);
+
+      cout << "got " << doc["title"].asString()
+           << " | expected TOML Example\n";
+      cout << "got " << doc["servers"]["beta"]["role"].asString()
+           << " | expected backend\n";
+      cout << "got " << doc["database"]["ports"][2].asInteger()
+           << " | expected 8002\n";
+      cout << "got " << doc["products"].asArray().size()
+           << " | expected 3\n";
+      cout << "got " << doc["products"][2]["color"].asString()
+           << " | expected gray\n";
+      cout << "got " << doc["products"][1].asTable().size()
+           << " | expected 0\n";
+      cout << "got " << doc["fruit"]["apple"]["taste"]["sweet"].asBoolean()
+           << " | expected 1\n";
+      cout << "got " << doc["times"]["quoted key"].asString()
+           << " | expected literal \\string\n";
+      cout << "got " << typeName(doc["owner"]["dob"].type())
+           << " | expected offset date-time\n";
+      cout << "got " << bool(doc["servers"]["gamma"]["ip"])
+           << " | expected 0\n";
+      cout << "got " << bool(doc["database"]["ports"][3])
+           << " | expected 0\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   try {
+      Document doc = parse(example);
+      doc["title"].asInteger();
+      cout << "TEST FAILED: Expected Exception.\n";
+   }
+   catch (const Exception &ex) {
+      cout << "TEST PASSED (got Exception: " << ex.what() << ")\n";
+   }
+
+   // Every field of a date-time must survive being packed into a cell.
+   try {
+      Document doc = parse("a = 9999-12-31T23:59:60.999999999-23:59");
+      cout << "got ";
+      print(cout, doc["a"], 0);
+      cout << " | expected 9999-12-31T23:59:60.999999999-23:59\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+}
+
+void TomlTest::testValid() {
+   vector<string> documentsThatShouldParse = {
+      "",
+      "# only a comment",
+      "a = 1\r\nb = 2\r\n",
+      "a = [\n  1,\n  2, # comment\n]",
+      "a = [ [ ], [ [ 1 ] ], { } ]",
+      "a = { b.c = 1, b.d = 2 }",
+      "a.b.c = 1\na.b.d = 2",
+      "[a.b.c]\n[a]\nx = 1",
+      "[a]\nb.c = 1\n[a.b.d]",
+      "[[a]]\n[a.b]\n[[a]]\n[a.b]",
+      "\"a.b\" = 1\na.b = 2",
+      "1.2 = 3",
+      "true = false",
+      "a = 2000-02-29",
+      "a = 23:59:60",
+      "a = 9999-12-31T23:59:59.999999999-23:59",
+   };
+
+   for (const string &s : documentsThatShouldParse) {
+      try {
+         parse(s);
+         cout << "TEST PASSED\n";
+      }
+      catch (const SyntaxError &ex) {
+         cout << "TEST FAILED: ";
+         cout.flush();
+         logSyntaxError(ex);
+      }
+   }
+}
+
+void TomlTest::testInvalid() {
+   vector<string> documentsThatShouldFail = {
+      "a = 1\na = 2",
+      "a = 1 2",
+      "a =",
+      "= 1",
+      "a",
+      "a = [ 1 2 ]",
+      "a = [ 1,, ]",
+      "a = { b = 1, }",
+      "a = { b = 1 c = 2 }",
+      "a = { b = 1, b = 2 }",
+      "[a]\n[a]",
+      "[a.b]\n[a]\n[a]",
+      "a = 1\n[a]",
+      "a = {}\n[a]",
+      "a = {}\na.b = 1",
+      "a = { b = {} }\n[a.b]",
+      "[a]\nb = 1\n[a.b]",
+      "[a]\nb.c = 1\n[a.b]",
+      "[a.b]\n[a]\nb.c = 1",
+      "a = []\n[[a]]",
+      "[[a]]\n[a]",
+      "[a]\n[[a]]",
+      "[a] b = 1",
+      "[[a]",
+      "\"\"\"a\"\"\" = 1",
+      "a = 1979-13-01",
+      "a = 1979-00-01",
+      "a = 1900-02-29",
+      "a = 1979-04-31",
+      "a = 24:00:00",
+      "a = 1979-05-27T07:60:00",
+      "a = 1979-05-27T07:32:00+24:00",
+      "a = \"\\u12\"",
+      "a = \"\\uD800\"",
+      "a = \"\\U00110000\"",
+   };
+
+   for (const string &s : documentsThatShouldFail) {
+      try {
+         parse(s);
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      catch (const SyntaxError &ex) {
+         cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+              << ex.col << ": " << ex.what() << ")\n";
+      }
+   }
+}
+
+void TomlTest::testSources() {
+   string path = "toml-test-example.toml";
+   ofstream(path) << example;
+
+   try {
+      string expected = print(parse(example));
+
+      istringstream iss(example);
+      string got = print(parse(iss));
+      if (got == expected) {
+         cout << "TEST PASSED (istream document matches)\n";
+      }
+      else {
+         cout << "TEST FAILED: istream document differs:\n" << got << '\n';
+      }
+
+      got = print(parseFile(path));
+      if (got == expected) {
+         cout << "TEST PASSED (file document matches)\n";
+      }
+      else {
+         cout << "TEST FAILED: file document differs:\n" << got << '\n';
+      }
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   remove(path.c_str());
+}
+
+// Tables big enough to be hashed must find every key, in both the builder
+// (duplicate detection) and the finished document, and still iterate in
+// source order.
+void TomlTest::testLargeTables() {
+   const int n = 5000;
+   string doc;
+   for (int i = 0; i < n; ++i) {
+      doc += "key_" + to_string(i) + " = " + to_string(i) + '\n';
+   }
+   doc += "[table]\ninline = { ";
+   for (int i = 0; i < 20; ++i) {
+      doc += (i ? ", k" : "k") + to_string(i) + " = " + to_string(i);
+   }
+   doc += " }\n";
+
+   try {
+      Document document = parse(doc);
+      int missing = 0;
+      for (int i = 0; i < n; ++i) {
+         Value value = document["key_" + to_string(i)];
+         if (!value || value.asInteger() != i) {
+            ++missing;
+         }
+      }
+      cout << "got " << missing << " keys missing | expected 0\n";
+      cout << "got " << bool(document["key_" + to_string(n)])
+           << " | expected 0\n";
+      cout << "got " << document["table"]["inline"]["k17"].asInteger()
+           << " | expected 17\n";
+
+      int outOfOrder = 0;
+      int i = 0;
+      for (Table::Entry entry : document.root()) {
+         if (i < n && entry.key != "key_" + to_string(i)) {
+            ++outOfOrder;
+         }
+         ++i;
+      }
+      cout << "got " << outOfOrder << " keys out of order | expected 0\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   vector<string> documentsThatShouldFail = {
+      "key_1234 = 0\n" + doc,
+      doc + "[key_4321]",
+      doc + "[table]",
+      doc + "[table.inline]",
+   };
+
+   for (const string &s : documentsThatShouldFail) {
+      try {
+         parse(s);
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      catch (const SyntaxError &ex) {
+         cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+              << ex.col << ": " << ex.what() << ")\n";
+      }
+   }
+}
+
+void TomlTest::testArena() {
+   CountingResource resource;
+   {
+      Document doc = parse(example, &resource);
+      Document moved = move(doc);
+      cout << "got " << moved["servers"]["alpha"]["ip"].asString()
+           << " | expected 10.0.0.1\n";
+      if (resource.allocations > 0 && resource.allocations < 10) {
+         cout << "TEST PASSED (" << resource.allocations
+              << " arena allocations)\n";
+      }
+      else {
+         cout << "TEST FAILED: got " << resource.allocations
+              << " arena allocations | expected 1 to 9\n";
+      }
+      // Parsing scratch memory is gone; the document is one block.
+      cout << "got " << resource.allocations - resource.deallocations
+           << " blocks held | expected 1\n";
+   }
+   cout << "got " << resource.deallocated << " bytes released | expected "
+        << resource.allocated << '\n';
+}
+
+void TomlTest::testInterning() {
+   string products = "title = \"catalog\"\n";
+   for (int i = 0; i < 50; ++i) {
+      products += "[[products]]\nname = \"item\"\nsku = "
+                  + to_string(i) + "\ncolor = \"gray\"\n";
+   }
+   products += "[notes]\nlong = \"" + string(100, 'x') + "\"\n";
+
+   try {
+      // Repeated keys and strings should read back the same with or
+      // without a shared pool.
+      ParseOptions options;
+      options.strings = make_shared<StringPool>(1 << 20);
+      string expected = print(parse(products));
+      Document first = parse(products, options);
+      cout << "got " << (print(first) == expected) << " | expected 1\n";
+
+      // title, products, name, sku, color, notes, long, catalog, item and
+      // gray; the long string isn't interned.
+      size_t count = options.strings->count();
+      cout << "got " << count << " pooled strings | expected 10\n";
+
+      // A second document reuses the pooled strings.
+      Document second = parse(products, options);
+      cout << "got " << options.strings->count() << " pooled strings"
+           << " | expected " << count << '\n';
+      cout << "got " << (first["products"][49]["name"].asString().data()
+                         == second["products"][49]["name"].asString().data())
+           << " | expected 1\n";
+      cout << "got " << second["products"][49]["sku"].asInteger()
+           << " | expected 49\n";
+      cout << "got " << second["notes"]["long"].asString().size()
+           << " | expected 100\n";
+
+      // Documents keep the pool alive.
+      options.strings.reset();
+      cout << "got " << second["title"].asString() << " | expected catalog\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+}
+
+void TomlTest::testEvents() {
+   const char *doc = R"(title = "events"
+a."b c" = [1, 2.5, {x = true, y = []}]
+[server]
+started = 1979-05-27T07:32:00Z
+[[products]]
+day = 2020-01-01
+at = 07:32:00
+)";
+   const char *expected = R"(key title
+string events
+key a.b c
+[
+integer 1
+float 2.5
+{
+key x
+boolean 1
+key y
+[
+]
+}
+]
+table server
+key started
+date-time
+array table products
+key day
+date
+key at
+time
+)";
+
+   try {
+      RecordingHandler handler;
+      parseEvents(doc, handler);
+      string got = handler.out.str();
+      if (got == expected) {
+         cout << "TEST PASSED (" << count(got.begin(), got.end(), '\n')
+              << " events)\n";
+      }
+      else {
+         cout << "TEST FAILED: got\n" << got << "expected\n" << expected;
+      }
+
+      RecordingHandler streamed;
+      istringstream in(doc);
+      parseEvents(in, streamed);
+      cout << "got " << (streamed.out.str() == got) << " | expected 1\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   // Grammar errors are still found without a Document. Keys defined twice
+   // are the handler's business, so they are not.
+   try {
+      RecordingHandler handler;
+      parseEvents("a = [1 2]", handler);
+      cout << "TEST FAILED: Expected SyntaxError.\n";
+   }
+   catch (const SyntaxError &ex) {
+      cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+           << ex.col << ": " << ex.what() << ")\n";
+   }
+   try {
+      RecordingHandler handler;
+      parseEvents("a = 1\na = 2", handler);
+      cout << "TEST PASSED (no SyntaxError)\n";
+   }
+   catch (const SyntaxError &ex) {
+      cout << "TEST FAILED: got SyntaxError: " << ex.what() << '\n';
+   }
+}
+
+void TomlTest::testReader() {
+   using Event = Reader<Tokenizer<0, BufferSource>>::Event;
+
+   // Pick out the owner's name and the second port, skipping everything
+   // else: whole sections, values and the rest of the ports array.
+   try {
+      Tokenizer<0, BufferSource> tokenizer(example);
+      Reader reader(tokenizer);
+      ostringstream got;
+      string section;
+      for (Event e = reader.next(); e != Event::End; e = reader.next()) {
+         if (e == Event::TableHeader || e == Event::ArrayTableHeader) {
+            section = join(reader.key());
+            if (section != "owner" && section != "database") {
+               reader.skip();
+            }
+         }
+         else if (e == Event::Key) {
+            string key = join(reader.key());
+            if (section == "owner" && key == "name") {
+               reader.next();
+               got << reader.asString() << '\n';
+            }
+            else if (section == "database" && key == "ports") {
+               reader.next();
+               reader.next();
+               reader.next();
+               got << reader.asInteger() << '\n';
+               reader.skip();
+            }
+            else {
+               reader.skip();
+            }
+         }
+      }
+      const char *expected = "Tom Preston-Werner\n8001\n";
+      if (got.str() == expected) {
+         cout << "TEST PASSED (read 2 values, skipped the rest)\n";
+      }
+      else {
+         cout << "TEST FAILED: got\n" << got.str() << "expected\n"
+              << expected;
+      }
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   // A lazy Tokenizer leaves values for the Reader to decode when asked.
+   try {
+      Tokenizer<0, BufferSource> tokenizer("a = \"x\\ty\"\nb = 1_000\n");
+      tokenizer.lazy(true);
+      Reader reader(tokenizer);
+      reader.next();
+      reader.next();
+      string a(reader.asString());
+      reader.next();
+      reader.next();
+      cout << "got " << (a == "x\ty") << ' ' << reader.asInteger()
+           << " | expected 1 1000\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   // Skipped parts are only checked as far as the Tokenizer checks them, so
+   // a bad date in a skipped value goes unnoticed, but unbalanced brackets
+   // do not.
+   try {
+      Tokenizer<0, BufferSource> tokenizer("a = [1979-13-45, {b = 1}]\nc = 2");
+      Reader reader(tokenizer);
+      reader.next();
+      reader.skip();
+      reader.next();
+      reader.next();
+      cout << "got " << join(reader.key()) << ' ' << reader.asInteger()
+           << " | expected c 2\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+   // A date-time written with a space is skipped whole, at the top level as
+   // in arrays.
+   try {
+      Tokenizer<0, BufferSource> tokenizer(
+         "a = 1979-05-27 07:32:00\nb = [1979-05-27 07:32:00Z]\nc = 2\n");
+      Reader reader(tokenizer);
+      reader.next();
+      reader.skip();
+      reader.next();
+      reader.skip();
+      reader.next();
+      reader.next();
+      cout << "got " << join(reader.key()) << ' ' << reader.asInteger()
+           << " | expected c 2\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+   try {
+      Tokenizer<0, BufferSource> tokenizer("a = [1, {b = 1]\nc = 2");
+      Reader reader(tokenizer);
+      reader.next();
+      reader.skip();
+      reader.next();
+      cout << "TEST FAILED: Expected SyntaxError.\n";
+   }
+   catch (const SyntaxError &ex) {
+      cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+           << ex.col << ": " << ex.what() << ")\n";
+   }
+}
+
+void TomlTest::testQueries() {
+   try {
+      Document doc = parse(example);
+      Document other = parse("[servers.gamma]\nip = \"10.0.0.3\"\n");
+
+      Query ip("servers.*.ip");
+      ostringstream got;
+      ip.forEach(doc, [&](Value v) { got << v.asString() << ' '; });
+      ip.forEach(other, [&](Value v) { got << v.asString() << ' '; });
+      cout << "got " << got.str() << "| expected 10.0.0.1 10.0.0.2 10.0.0.3 \n";
+
+      cout << "got " << Query("database.data[0][1]").find(doc).asString()
+           << " | expected phi\n";
+      cout << "got " << Query(" times . 'quoted key' ").find(doc).asString()
+           << " | expected literal \\string\n";
+      cout << "got " << Query("\"fruit\".apple.taste.sweet").find(doc)
+                        .asBoolean()
+           << " | expected 1\n";
+      cout << "got " << Query("products[*].sku").find(doc).asInteger()
+           << " | expected 738594937\n";
+
+      int skus = 0;
+      Query("products[*].sku").forEach(doc, [&](Value) { ++skus; });
+      cout << "got " << skus << " | expected 2\n";
+
+      // Paths that lead nowhere find nothing.
+      bool none = !Query("database.ports[3]").find(doc)
+                  && !Query("title[0]").find(doc)
+                  && !Query("database[*]").find(doc)
+                  && !Query("owner.*.x").find(doc);
+      cout << "got " << none << " | expected 1\n";
+
+      // Lookups can start from any value.
+      Value database = doc["database"];
+      cout << "got " << Query("temp_targets.cpu").find(database).asFloat()
+           << " | expected 79.5\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   vector<string> pathsThatShouldFail = {
+      "",
+      "a.",
+      "a..b",
+      "a[",
+      "a[x]",
+      "a[1",
+      "a b",
+      "\"a",
+      "\"\\q\"",
+      "a[99999999999]"
+   };
+
+   for (const string &path : pathsThatShouldFail) {
+      try {
+         Query query(path);
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      catch (const SyntaxError &ex) {
+         cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+              << ex.col << ": " << ex.what() << ")\n";
+      }
+   }
+}
+
+void TomlTest::testBinding() {
+   try {
+      Example ex;
+      parseInto(example, ex);
+
+      ostringstream got;
+      got << ex.title << '|' << ex.owner.name << '|' << ex.owner.dob.date.year
+          << '|' << ex.database.enabled << '|' << ex.database.ports.size()
+          << ' ' << ex.database.ports[2] << '|'
+          << ex.database.temp_targets.cpu << ' '
+          << ex.database.temp_targets.gpu << '|' << ex.servers.alpha.ip << '|'
+          << ex.servers.beta->role << '|' << ex.servers.gamma.has_value()
+          << '|' << ex.products.size() << ' ' << ex.products[0].sku << ' '
+          << ex.products[1].name.empty() << ' ' << *ex.products[2].color
+          << '|' << ex.times.date.day << ' ' << ex.times.time.nanosecond
+          << ' ' << ex.times.local.offset.has_value() << ' '
+          << ex.times.quoted;
+      string expected = "TOML Example|Tom Preston-Werner|1979|1|3 8002|"
+                        "79.5 72|10.0.0.1|backend|0|3 738594937 1 gray|"
+                        "27 500000000 0 literal \\string";
+      if (got.str() == expected) {
+         cout << "TEST PASSED (bound the example)\n";
+      }
+      else {
+         cout << "TEST FAILED: got " << got.str() << " | expected "
+              << expected << '\n';
+      }
+
+      // Dotted keys and arrays of inline tables bind too, and unknown keys
+      // are skipped whatever their values look like.
+      Example dotted;
+      parseInto("owner.name = 'x'\n"
+                "updated = 1979-05-27 07:32:00\n"
+                "products = [{name = 'a'}, {name = 'b', sku = 2}]\n"
+                "[servers]\nalpha.ip = 'y'\n"
+                "checked = 1979-05-27 07:32:00.5\n", dotted);
+      cout << "got " << dotted.owner.name << ' ' << dotted.products.size()
+           << ' ' << dotted.products[1].sku << ' ' << dotted.servers.alpha.ip
+           << " | expected x 2 2 y\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   vector<string> docsThatShouldFail = {
+      "title = 1",
+      "database.ports = [1, 'x']",
+      "database.ports = [70000]",
+      "[database]\ntemp_targets = 5",
+      "[[servers]]",
+      "title.x = 1",
+      "owner = {name = 'x'\n}"
+   };
+
+   for (const string &doc : docsThatShouldFail) {
+      try {
+         Example ex;
+         parseInto(doc, ex);
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      catch (const SyntaxError &ex) {
+         cout << "TEST PASSED (got SyntaxError at " << ex.line << ':'
+              << ex.col << ": " << ex.what() << ")\n";
+      }
+   }
+}
+
+void TomlTest::testWriter() {
+   try {
+      // Writing a document and reading it back gives the same document, and
+      // writing that gives the same text.
+      Document doc = parse(example);
+      string first;
+      Writer(first).document(doc);
+      Document reread = parse(first);
+      string second;
+      Writer(second).document(reread);
+      cout << "got " << (print(reread) == print(doc)) << (second == first)
+           << " | expected 11\n";
+
+      string out;
+      Writer writer(out);
+      writer.key("title");
+      writer.value("example");
+      writer.tableHeader({ "servers", "alpha" });
+      writer.key("ports");
+      writer.beginArray();
+      writer.value(8000);
+      writer.endArray();
+      string expected = "title = \"example\"\n\n[servers.alpha]\n"
+                        "ports = [8000]\n";
+      if (out == expected) {
+         cout << "TEST PASSED (streamed a document)\n";
+      }
+      else {
+         cout << "TEST FAILED: got " << out << " | expected " << expected
+              << '\n';
+      }
+
+      out.clear();
+      Writer values(out);
+      values.key({ "a b", "c" });
+      values.value("q\"\\\n\x01é");
+      values.key("f");
+      values.beginArray();
+      values.value(1.0);
+      values.value(1e22);
+      values.value(-0.5);
+      values.value(numeric_limits<double>::infinity());
+      values.endArray();
+      values.key("t");
+      values.beginInlineTable();
+      values.key("a");
+      values.value(1);
+      values.key("e");
+      values.beginInlineTable();
+      values.endInlineTable();
+      values.endInlineTable();
+      values.key("d");
+      values.value(parse("d = 1979-05-27T07:32:00.5Z")["d"].asDateTime());
+      expected = "\"a b\".c = \"q\\\"\\\\\\n\\u0001\\u00E9\"\n"
+                 "f = [1.0, 1e+22, -0.5, inf]\n"
+                 "t = { a = 1, e = {} }\n"
+                 "d = 1979-05-27T07:32:00.5Z\n";
+      if (out == expected) {
+         cout << "TEST PASSED (wrote keys and values)\n";
+      }
+      else {
+         cout << "TEST FAILED: got " << out << " | expected " << expected
+              << '\n';
+      }
+
+      // Control characters and DEL are escaped as \u00XX, and read back.
+      string control = "\x01\x1f\x7f\tx";
+      out.clear();
+      Writer escapes(out);
+      escapes.key(control);
+      escapes.value(control);
+      Document escaped = parse(out);
+      Table::Entry entry = *escaped.root().begin();
+      cout << "got " << (entry.key == control) << ' '
+           << (entry.value.asString() == control) << ' '
+           << (parse("a = \"\\u00E9\\U0001F600\"")["a"].asString()
+               == "\xc3\xa9\xf0\x9f\x98\x80")
+           << " | expected 1 1 1\n";
+
+      // So are characters past ASCII, in keys and values alike.
+      out.clear();
+      Writer unicode(out);
+      unicode.document(parse("\"k\\u00E9\" = \"\\u00E9 \\U0001F600\""));
+      expected = "\"k\\u00E9\" = \"\\u00E9 \\U0001F600\"\n";
+      if (out == expected) {
+         cout << "TEST PASSED (escaped non-ASCII characters)\n";
+      }
+      else {
+         cout << "TEST FAILED: got " << out << " | expected " << expected
+              << '\n';
+      }
+      Document unescaped = parse(out);
+      cout << "got "
+           << (unescaped["k\xc3\xa9"].asString()
+               == "\xc3\xa9 \xf0\x9f\x98\x80")
+           << " | expected 1\n";
+
+      // A file descriptor gets what was written once the Writer flushes.
+      FILE *file = tmpfile();
+      {
+         Writer fdWriter(fileno(file));
+         fdWriter.document(doc);
+      }
+      rewind(file);
+      string written;
+      char buf[4096];
+      size_t n;
+      while ((n = fread(buf, 1, sizeof buf, file)) > 0) {
+         written.append(buf, n);
+      }
+      fclose(file);
+      cout << "got " << (written == first) << " | expected 1\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   vector<void (*)(Writer &)> misuses = {
+      [](Writer &w) { w.value(1); },
+      [](Writer &w) { w.key("a"); w.key("b"); },
+      [](Writer &w) { w.key("a"); w.beginArray(); w.tableHeader({ "t" }); },
+      [](Writer &w) { w.key("a"); w.beginArray(); w.key("b"); },
+      [](Writer &w) { w.key("a"); w.beginArray(); w.endInlineTable(); },
+      [](Writer &w) { w.key("a"); w.beginInlineTable(); w.endArray(); },
+      [](Writer &w) { w.key("a"); w.value("\xc3"); },
+      [](Writer &w) { w.key("a"); w.value("\xed\xa0\x80"); }
+   };
+
+   for (auto misuse : misuses) {
+      try {
+         string out;
+         Writer writer(out);
+         misuse(writer);
+         cout << "TEST FAILED: Expected Exception.\n";
+      }
+      catch (const Exception &ex) {
+         cout << "TEST PASSED (got Exception: " << ex.what() << ")\n";
+      }
+   }
+}
+
+// Parses the parts of a document separately and merges them, as a parallel
+// parse does.
+bool mergeParts(const vector<string> &parts, string &printed) {
+   vector<unique_ptr<DocumentBuilder>> builders;
+   for (const string &part : parts) {
+      builders.push_back(make_unique<DocumentBuilder>());
+      parseEvents(part, *builders.back());
+   }
+   for (size_t i = 1; i < builders.size(); ++i) {
+      if (!builders[0]->merge(*builders[i])) {
+         return false;
+      }
+   }
+   printed = print(builders[0]->finish());
+   return true;
+}
+
+void TomlTest::testParallel() {
+   ParseOptions parallel;
+   parallel.threads = 4;
+   parallel.minChunk = 1;
+
+   string crossing = "[a.b]\nx = 1\n[a]\ny = 'y'\n[[arr]]\nn = 1\n"
+                     "[arr.sub]\nz = 1\n[[arr]]\nn = 2\n[a.c]\nw = 'y'\n"
+                     "[a.b.d]\n[d]\ne.f = 1\n[d.e.g]\n";
+   vector<string> documents = {
+      example,
+      crossing,
+      "s = \"\"\"\n[not.a.table]\n\"\"\"\nm = [\n[1, 2]\n]\n[t]\nk = 1\n"
+   };
+
+   for (const string &doc : documents) {
+      try {
+         string expected = print(parse(doc));
+         string got = print(parse(doc, parallel));
+         if (got == expected) {
+            cout << "TEST PASSED (parallel parse matches)\n";
+         }
+         else {
+            cout << "TEST FAILED: got\n" << got << "expected\n" << expected;
+         }
+      }
+      catch (const SyntaxError &ex) {
+         logSyntaxError(ex);
+      }
+   }
+
+   // Documents without headers to split at have their arrays split instead.
+   string arrays = "a = [1, 'two', [3, [4]], {x = 5, y = [6]}, \"\"\"se,\n"
+                   "]ven\"\"\"\"\", # eight, ]\n 9.5, 1979-05-27, '''\n,'''"
+                   ", \"\\\",\", ]\nb = [ ]\nc = [\n1\n]\n"
+                   "d = [[1, 2], [3, 4]]\ne.f = ['x', 'y']\n";
+   try {
+      string expected = print(parse(arrays));
+      string got = print(parse(arrays, parallel));
+      if (got == expected) {
+         cout << "TEST PASSED (parallel arrays match)\n";
+      }
+      else {
+         cout << "TEST FAILED: got\n" << got << "expected\n" << expected;
+      }
+
+      ArraySplit split;
+      bool splits = ArraySplitter(arrays).split(
+         ArraySplit::Position{ 4, 1, 5 }, 4, 1, split);
+      cout << "got " << splits << ' ' << split.starts.size() << ' '
+           << split.starts[1].offset << ' ' << split.close.line << ':'
+           << split.close.col << " | expected 1 4 24 4:14\n";
+   }
+   catch (const SyntaxError &ex) {
+      logSyntaxError(ex);
+   }
+
+   // Merging the parts directly, without the fallback to a parse on one
+   // thread, gives the same document.
+   vector<string> parts = {
+      "[a.b]\nx = 1\n", "[a]\ny = 'y'\n[[arr]]\nn = 1\n",
+      "[arr.sub]\nz = 1\n", "[[arr]]\nn = 2\n[a.c]\nw = 'y'\n",
+      "[a.b.d]\n[d]\ne.f = 1\n", "[d.e.g]\n"
+   };
+   string merged;
+   cout << "got " << mergeParts(parts, merged)
+        << (merged == print(parse(crossing))) << " | expected 11\n";
+
+   vector<vector<string>> conflictingParts = {
+      { "[a]\n", "[a]\n" },
+      { "a = 1\n", "[a]\n" },
+      { "[a]\nb = 1\n", "[a.b]\n" },
+      { "[a.b]\n", "[a]\nb = 1\n" },
+      { "[a.b]\n", "[a]\nb.c = 1\n" },
+      { "a = { b = 1 }\n", "[a.c]\n" },
+      { "[[a]]\n", "[a]\n" },
+      { "[a]\n", "[[a]]\n" }
+   };
+   int conflicts = 0;
+   for (const vector<string> &conflicting : conflictingParts) {
+      conflicts += !mergeParts(conflicting, merged);
+   }
+   cout << "got " << conflicts << " | expected " << conflictingParts.size()
+        << '\n';
+
+   // Errors are reported where they are in the whole document.
+   vector<string> documentsThatShouldFail = {
+      crossing + "[a]\n",
+      crossing + "[arr]\n",
+      crossing + "[x]\ny = \n",
+      crossing + "[y]\ns = \"\"\"\n[z]\n",
+      "a = [1, 2,\n, 3]\nb = 1\n",
+      "a = [1, 2,\n3 4]\n",
+      "a = [1, 2, {b = 1, b = 2}]\n",
+      "a = [1, 2, 3\nb = 1\n",
+      "a = [1, 2, 'x\n', 3]\n"
+   };
+
+   for (const string &doc : documentsThatShouldFail) {
+      string expected;
+      try {
+         parse(doc);
+      }
+      catch (const SyntaxError &ex) {
+         expected = to_string(ex.line) + ':' + to_string(ex.col) + ": "
+                    + ex.what();
+      }
+      try {
+         parse(doc, parallel);
+         cout << "TEST FAILED: Expected SyntaxError.\n";
+      }
+      catch (const SyntaxError &ex) {
+         string got = to_string(ex.line) + ':' + to_string(ex.col) + ": "
+                      + ex.what();
+         if (got == expected) {
+            cout << "TEST PASSED (got SyntaxError at " << got << ")\n";
+         }
+         else {
+            cout << "TEST FAILED: got " << got << " | expected " << expected
+                 << '\n';
+         }
+      }
+   }
+}
+
+void TomlTest::testParseFiles() {
+   char dir[] = "/tmp/toml-test-XXXXXX";
+   if (!mkdtemp(dir)) {
+      cout << "TEST FAILED: could not create " << dir << '\n';
+      return;
+   }
+
+   // Files of different sizes, so that they are taken out of order
+   vector<string> contents;
+   for (int i = 0; i < 12; ++i) {
+      string doc = "n = " + to_string(i) + '\n';
+      for (int j = 0; j < i * 100; ++j) {
+         doc += "k" + to_string(j) + " = 'x'\n";
+      }
+      contents.push_back(doc);
+   }
+   contents[5] = "n = 5\nbad = \n";
+
+   vector<string> paths;
+   for (size_t i = 0; i < contents.size(); ++i) {
+      string path = string(dir) + "/file" + (i < 10 ? "0" : "")
+                    + to_string(i) + ".toml";
+      ofstream(path) << contents[i];
+      paths.push_back(path);
+   }
+   paths.push_back(string(dir) + "/missing.toml");
+
+   ParseOptions options;
+   options.threads = 3;
+   vector<LoadedFile> files = parseFiles(paths, options);
+
+   int loaded = 0;
+   for (size_t i = 0; i < contents.size(); ++i) {
+      if (i != 5 && files[i].path == paths[i] && files[i].document
+          && (*files[i].document)["n"].asInteger() == int(i)
+          && (*files[i].document).root().size() == i * 100 + 1)
+      {
+         ++loaded;
+      }
+   }
+   cout << "got " << loaded << " | expected 11\n";
+   cout << "got " << bool(files[5].document) << ' ' << files[5].line << ':'
+        << files[5].col << ' ' << files[5].error
+        << " | expected 0 2:7 Expected a value\n";
+   cout << "got " << bool(files[12].document) << ' ' << files[12].line << ' '
+        << !files[12].error.empty() << " | expected 0 0 1\n";
+
+   vector<LoadedFile> globbed = parseGlob(string(dir) + "/*.toml", options);
+   cout << "got " << globbed.size() << ' ' << (globbed[3].path == paths[3])
+        << ' ' << bool(globbed[11].document) << " | expected 12 1 1\n";
+   cout << "got " << parseGlob(string(dir) + "/*.json").size()
+        << " | expected 0\n";
+
+   for (size_t i = 0; i < contents.size(); ++i) {
+      unlink(paths[i].c_str());
+   }
+   rmdir(dir);
+}
+
+void TomlTest::testSnapshots() {
+   LiveDocument live(parse("a = 1\n[s]\nb = 'x'\nc = [1, 2]\n"));
+   KeyHandle b("s.b");
+   KeyHandle c1("s.c[1]");
+   KeyHandle none("s.d");
+
+   Snapshot first = live.load();
+   cout << "got " << b.find(first).asString() << ' '
+        << c1.find(first).asInteger() << ' ' << bool(none.find(first))
+        << " | expected x 2 0\n";
+
+   // Same layout: the handles go straight to their cells.
+   live.publish(parse("a = 2\n[s]\nb = 'yy'\nc = [3, 4]\n"));
+   Snapshot second = live.load();
+   cout << "got " << (second.layout() == first.layout()) << ' '
+        << b.find(second).asString() << ' ' << c1.find(second).asInteger()
+        << ' ' << bool(none.find(second)) << " | expected 1 yy 4 0\n";
+
+   // A different layout: the handles search again.
+   live.publish(parse("[s]\nd = true\nb = 'z'\n"));
+   Snapshot third = live.load();
+   cout << "got " << (third.layout() == second.layout()) << ' '
+        << b.find(third).asString() << ' ' << bool(c1.find(third)) << ' '
+        << none.find(third).asBoolean() << " | expected 0 z 0 1\n";
+
+   // Earlier snapshots stay readable, and handles still find their values.
+   cout << "got " << first["a"].asInteger() << ' ' << b.find(first).asString()
+        << ' ' << b.find(second).asString() << " | expected 1 x yy\n";
+
+   // Separately parsed documents get layouts of their own.
+   Snapshot other(parse("a = 2\n[s]\nb = 'yy'\nc = [3, 4]\n"));
+   cout << "got " << (other.layout() == second.layout()) << ' '
+        << bool(Snapshot()) << ' ' << bool(b.find(Snapshot()))
+        << " | expected 0 0 0\n";
+
+   // Readers never see a document other than a whole published one.
+   LiveDocument counter(parse("a = 0\nb = 0\n"));
+   KeyHandle a("a");
+   int publishes = 200;
+   vector<thread> readers;
+   vector<int> torn(4);
+   for (int t = 0; t < 4; ++t) {
+      readers.emplace_back([&, t] {
+         int64_t seen = 0;
+         while (seen < publishes) {
+            Snapshot snapshot = counter.load();
+            seen = a.find(snapshot).asInteger();
+            if (snapshot["b"].asInteger() != seen) {
+               ++torn[t];
+            }
+         }
+      });
+   }
+   for (int i = 1; i <= publishes; ++i) {
+      string n = to_string(i);
+      counter.publish(parse("a = " + n + "\nb = " + n + "\n"));
+   }
+   for (thread &reader : readers) {
+      reader.join();
+   }
+   cout << "got " << count(torn.begin(), torn.end(), 0)
+        << " | expected 4\n";
+}
+
+void TomlTest::testIncremental() {
+   string base = "title = 'x'\n[a.b]\nx = 1\n[a]\ny = 'y'\n[[arr]]\nn = 1\n"
+                 "[arr.sub]\nz = 1\n[[arr]]\nn = 2\n[t]\nk = 1\n"
+                 "m = [\n[1, 2]\n]\n[u]\nv = 'end'\n";
+   IncrementalDocument doc(base);
+
+   // Each edit replaces the first occurrence of a string, and the document
+   // should be what parsing the edited text gives.
+   struct Edit {
+      string from;
+      string to;
+   };
+   vector<Edit> edits = {
+      { "x = 1", "x = 100" },
+      { "[a]\ny", "w = 3\n[a]\ny" },
+      { "k = 1", "k = \"\"\"\n[not.a.table]\n\"\"\"" },
+      { "[arr.sub]\n", "" },
+      { "y = 'y'", "y = 'y'\n[c]\nq = 1" },
+      { "y = 'y'\n[c]\nq = 1\n[[arr]]\nn = 1", "y = 'two'\n[[arr]]\nn = 10" },
+      { "title", "# comment\ntitle" },
+      { "v = 'end'\n", "v = 'end'\n\n[z]\nlast = true\n" },
+      { "n = 2", "n = " },
+      { "v = 'end'", "v = 'end'\nv = 1" },
+      { "[u]", "[t]" },
+      { "last = true", "last = \"\"\"" },
+      { "k = \"\"\"", "k = '''" }
+   };
+
+   for (size_t i = 0; i < edits.size(); ++i) {
+      const Edit &edit = edits[i];
+      string text = doc.text();
+      size_t offset = text.find(edit.from);
+      text.replace(offset, edit.from.size(), edit.to);
+
+      string expected;
+      try {
+         expected = print(parse(text));
+      }
+      catch (const SyntaxError &ex) {
+         expected = to_string(ex.line) + ':' + to_string(ex.col) + ' '
+                    + ex.what();
+      }
+
+      string got;
+      string before = doc.text();
+      try {
+         doc.edit(offset, edit.from.size(), edit.to);
+         got = print(doc.snapshot().document());
+      }
+      catch (const SyntaxError &ex) {
+         got = to_string(ex.line) + ':' + to_string(ex.col) + ' '
+               + ex.what();
+         if (doc.text() != before) {
+            got += " (and the text changed)";
+         }
+      }
+
+      if (got == expected) {
+         cout << "TEST PASSED (edit " << i << " matches)\n";
+      }
+      else {
+         cout << "TEST FAILED: got\n" << got << "expected\n" << expected;
+      }
+   }
+
+   // A small edit tokenizes only the section it is in.
+   doc.edit(doc.text().find("x = 100"), 7, "x = 2");
+   cout << "got " << doc.reparsed() << ' '
+        << doc.snapshot()["a"]["b"]["x"].asInteger() << " | expected 18 2\n";
+
+   try {
+      doc.edit(doc.text().size(), 1, "");
+      cout << "TEST FAILED: an edit past the end was allowed\n";
+   }
+   catch (const Exception &ex) {
+      cout << "TEST PASSED (got Exception: " << ex.what() << ")\n";
+   }
+}
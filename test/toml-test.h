@@ -4,6 +4,25 @@
 class TomlTest {
 public:
    void run();
+
+private:
+   void testParse();
+   void testLookups();
+   void testValid();
+   void testInvalid();
+   void testSources();
+   void testLargeTables();
+   void testArena();
+   void testInterning();
+   void testEvents();
+   void testReader();
+   void testQueries();
+   void testBinding();
+   void testWriter();
+   void testParallel();
+   void testParseFiles();
+   void testSnapshots();
+   void testIncremental();
 };
 
 #endif
\ No newline at end of file